@@ -18,7 +18,14 @@
  **/
 
 #include <Python.h>
+#include <structmember.h>
 #include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <ason/ason.h>
 #include <ason/print.h>
 #include <ason/read.h>
@@ -27,16 +34,52 @@
 
 #if PY_MAJOR_VERSION < 3
 #define PYTHON2
+typedef long Py_hash_t;
+/* Python 2 has no way to tell a missing key from a failed lookup */
+#define PyDict_GetItemWithError PyDict_GetItem
 #endif
 
+/**
+ * Entry in the index of a list or object's members. Keys are UTF-8 and only
+ * set for objects. Members are only given an Ason object when they are first
+ * looked up; until then we have their span in the text of lazily parsed
+ * values, and their position (`order`, counting from 1) in parsed ones.
+ **/
+typedef struct {
+	char *key;
+	size_t key_len;
+	size_t order;
+	size_t start;
+	size_t end;
+	PyObject *child;
+} AsonIndexEntry;
+
 /**
  * ASON value object.
  **/
 typedef struct {
 	PyObject_HEAD
 	ason_t *value;
+	Py_hash_t hash;
+	PyObject *source;
+	Py_ssize_t start;
+	Py_ssize_t len;
+	int kind;
+	AsonIndexEntry *index;
+	Py_ssize_t index_len;
+	PyObject *index_source;
+	ason_iter_t *index_iter;
+	size_t index_pos;
 } Ason;
 
+/**
+ * What an AsonIter yields for each field of an object. Lists always give their
+ * items.
+ **/
+#define ASON_ITER_ITEMS 0
+#define ASON_ITER_KEYS 1
+#define ASON_ITER_VALUES 2
+
 /**
  * Ason iterator object
  **/
@@ -47,8 +90,121 @@ typedef struct {
 	int in_object;
 	int halt;
 	int enter_union;
+	int mode;
+	int plain;
+	PyObject *result;
+	PyObject *lazy;
+	size_t lazy_pos;
+	size_t lazy_end;
 } AsonIter;
 
+/**
+ * ASON expression which can be evaluated repeatedly with different variable
+ * bindings. The expression is scanned once for its variables, which are made
+ * once in a namespace of the template's own; each evaluation only stores the
+ * bindings and has libason read the expression against that namespace.
+ **/
+typedef struct {
+	PyObject_HEAD
+	char *text;
+	ason_ns_t *ns;
+	PyObject *variables;
+} AsonTemplate;
+
+/**
+ * Incremental reader which splits a stream into top-level ASON values.
+ * `busy` is set while a value is being read, as the GIL is released part way
+ * through and the buffer must not be changed under us meanwhile.
+ **/
+typedef struct {
+	PyObject_HEAD
+	PyObject *source;
+	int fd;
+	Py_ssize_t chunk_size;
+	char *data;
+	size_t size;
+	size_t start;
+	size_t len;
+	size_t scan;
+	int depth;
+	int in_string;
+	int escape;
+	int eof;
+	int busy;
+} AsonReader;
+
+/**
+ * Number of distinct families of concrete ASON values an AsonMatcher sorts
+ * values into.
+ **/
+#define ASON_MATCHER_FAMILIES 7
+
+/**
+ * Precomputed schema for fast repeated representation checks.
+ **/
+typedef struct {
+	PyObject_HEAD
+	ason_t *schema;
+	ason_t *families[ASON_MATCHER_FAMILIES];
+	PyObject *cache;
+	Py_ssize_t cache_size;
+	Py_ssize_t hits;
+	Py_ssize_t misses;
+} AsonMatcher;
+
+/**
+ * What to do with values that have no plain Python equivalent when
+ * converting with to_python(), or no JSON equivalent with to_json().
+ **/
+typedef enum {
+	ASON_FALLBACK_ERROR,
+	ASON_FALLBACK_ASON,
+	ASON_FALLBACK_STRING,
+	ASON_FALLBACK_NULL,
+} ason_fallback_t;
+
+static PyTypeObject ason_AsonType;
+static PyTypeObject ason_AsonIterType;
+
+static ason_t * Ason_value(Ason *self);
+static PyObject * iter_to_python(ason_iter_t *iter, ason_fallback_t fallback);
+static void Ason_clear_index(Ason *self);
+static int Ason_get_type(Ason *self);
+
+/**
+ * Kinds of step in an AsonPath.
+ **/
+#define ASON_PATH_ROOT 0
+#define ASON_PATH_KEY 1
+#define ASON_PATH_INDEX 2
+#define ASON_PATH_ANY 3
+
+/**
+ * Node in the tree of steps for an AsonPath. Paths with a common prefix share
+ * nodes, so the prefix is only walked once per value.
+ **/
+typedef struct {
+	int kind;
+	PyObject *key;
+	Py_ssize_t index;
+	Py_ssize_t child;
+	Py_ssize_t sibling;
+	int terminal;
+	int multi;
+} AsonPathNode;
+
+/**
+ * Compiled set of path expressions.
+ **/
+typedef struct {
+	PyObject_HEAD
+	AsonPathNode *nodes;
+	Py_ssize_t n_nodes;
+	Py_ssize_t *ends;
+	Py_ssize_t n_paths;
+	PyObject *expressions;
+} AsonPath;
+
 /**
  * Check whether this object is of the relevant string type for our language.
  **/
@@ -62,73 +218,273 @@ PyStringType_Check(PyObject *obj)
 	return PyUnicode_Check(obj);
 }
 
-#ifdef PYTHON2
-
-static PyObject *string_list = NULL;
-
 /**
- * Put a string on a list of strings we need to destroy later.
+ * Convert this string object to a C string, and get its length in bytes. On
+ * Python 2 a unicode object has to be encoded first; the encoded copy is
+ * returned in `hold` and must be released once the C string is no longer
+ * needed. Nothing here is shared between calls, so it is safe while other
+ * threads run.
  **/
-static int
-mark_string(PyObject *string)
+static char *
+PyStringType_AsUTF8AndSize(PyObject *obj, PyObject **hold, Py_ssize_t *len)
 {
-	if (! string_list)
-		string_list = PyList_New(0);
+	*hold = NULL;
 
-	if (! string_list)
-		return -1;
+#ifdef PYTHON2
+	if (PyUnicode_Check(obj)) {
+		*hold = PyUnicode_AsUTF8String(obj);
 
-	if (! PyList_Append(string_list, string))
-		return -1;
+		if (! *hold)
+			return NULL;
 
-	Py_DECREF(string);
-	return 0;
+		*len = PyString_GET_SIZE(*hold);
+		return PyString_AS_STRING(*hold);
+	}
+
+	if (PyString_Check(obj)) {
+		*len = PyString_GET_SIZE(obj);
+		return PyString_AS_STRING(obj);
+	}
+
+	PyErr_Format(PyExc_TypeError, "Cannot convert type to unicode");
+	return NULL;
+#else
+	return (char *)PyUnicode_AsUTF8AndSize(obj, len);
+#endif
 }
 
 /**
- * Get rid of used up strings
+ * Convert this string object to a C string, as for
+ * PyStringType_AsUTF8AndSize().
  **/
-static void
-sweep_strings(void)
+static char *
+PyStringType_AsUTF8(PyObject *obj, PyObject **hold)
 {
-	Py_CLEAR(string_list);
+	Py_ssize_t len;
+
+	return PyStringType_AsUTF8AndSize(obj, hold, &len);
 }
 
+/**
+ * Convert a C string to the relevant string type for our language.
+ **/
+static PyObject *
+PyStringType_FromString(const char *str)
+{
+#ifdef PYTHON2
+	return PyString_FromString(str);
 #else
-static void
-sweep_strings(void)
-{}
+	return PyUnicode_FromString(str);
 #endif
+}
 
 /**
- * Convert this string object to a C string.
+ * Convert a counted C string to the relevant string type for our language.
  **/
-static char *
-PyStringType_AsUTF8(PyObject *obj)
+static PyObject *
+PyStringType_FromStringAndSize(const char *str, Py_ssize_t len)
 {
 #ifdef PYTHON2
-	PyObject *str = NULL;
+	return PyString_FromStringAndSize(str, len);
+#else
+	return PyUnicode_FromStringAndSize(str, len);
+#endif
+}
 
-	if (PyUnicode_Check(obj)) {
-		str = PyUnicode_AsUTF8String(obj);
-		if (mark_string(str) < 0) {
-			Py_DECREF(str);
-			return NULL;
-		}
-	} else if (PyString_Check(obj)) {
-		str = obj;
-	} else {
-		PyErr_Format(PyExc_TypeError,
-			     "Cannot convert type to unicode");
+/**
+ * FNV-1a hash of some bytes.
+ **/
+static uint64_t
+ason_fnv1a(const char *data, size_t len)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/**
+ * Number of slots in the object key cache. Must be a power of two.
+ **/
+#define ASON_KEY_CACHE_SIZE 1024
+
+/**
+ * Longest key we keep in the key cache.
+ **/
+#define ASON_KEY_CACHE_MAX 64
+
+/**
+ * Slot in the object key cache.
+ **/
+typedef struct {
+	char key[ASON_KEY_CACHE_MAX];
+	size_t len;
+	PyObject *str;
+} AsonKeyCacheEntry;
+
+/**
+ * Python strings for recently seen object keys, so iterating many objects
+ * with the same fields makes each key string once. The strings are interned,
+ * so dict lookups with them hit on identity.
+ **/
+static AsonKeyCacheEntry key_cache[ASON_KEY_CACHE_SIZE];
+
+/**
+ * Get a Python string for an object key, from the key cache if we can.
+ **/
+static PyObject *
+ason_key_string(const char *key, size_t len)
+{
+	AsonKeyCacheEntry *entry;
+	PyObject *str;
+
+	if (len > ASON_KEY_CACHE_MAX)
+		return PyStringType_FromStringAndSize(key, len);
+
+	entry = &key_cache[ason_fnv1a(key, len) & (ASON_KEY_CACHE_SIZE - 1)];
+
+	if (entry->str && entry->len == len && ! memcmp(entry->key, key, len)) {
+		Py_INCREF(entry->str);
+		return entry->str;
 	}
 
+	str = PyStringType_FromStringAndSize(key, len);
+
 	if (! str)
 		return NULL;
 
-	return PyString_AsString(str);
+#ifdef PYTHON2
+	PyString_InternInPlace(&str);
 #else
-	return PyUnicode_AsUTF8(obj);
+	PyUnicode_InternInPlace(&str);
 #endif
+
+	Py_XDECREF(entry->str);
+	memcpy(entry->key, key, len);
+	entry->len = len;
+	entry->str = str;
+	Py_INCREF(str);
+	return str;
+}
+
+/**
+ * Empty the object key cache.
+ **/
+static void
+ason_key_cache_clear(void)
+{
+	size_t i;
+
+	for (i = 0; i < ASON_KEY_CACHE_SIZE; i++)
+		Py_CLEAR(key_cache[i].str);
+}
+
+/**
+ * Default number of dead objects a free list keeps for reuse.
+ **/
+#define ASON_FREE_LIST_DEFAULT 256
+
+/**
+ * Dead objects of one type kept for reuse, so short-lived wrappers don't go
+ * back to the allocator every time. Only objects of exactly our own types go
+ * on a free list, never subclasses.
+ **/
+typedef struct {
+	PyObject **items;
+	Py_ssize_t len;
+	Py_ssize_t limit;
+	Py_ssize_t hits;
+	Py_ssize_t misses;
+} AsonFreeList;
+
+static AsonFreeList ason_free_list = { NULL, 0, ASON_FREE_LIST_DEFAULT, 0, 0 };
+static AsonFreeList iter_free_list = { NULL, 0, ASON_FREE_LIST_DEFAULT, 0, 0 };
+
+/**
+ * Take an object of the given type from a free list, or allocate a new one.
+ **/
+static PyObject *
+AsonFreeList_pop(AsonFreeList *list, PyTypeObject *type)
+{
+	PyObject *ret;
+
+	if (! list->len) {
+		list->misses++;
+		return _PyObject_New(type);
+	}
+
+	list->hits++;
+	ret = list->items[--list->len];
+	return PyObject_Init(ret, type);
+}
+
+/**
+ * Put a dead object on a free list. Returns 0 if the list is full, in which
+ * case the caller should free the object itself.
+ **/
+static int
+AsonFreeList_push(AsonFreeList *list, PyObject *obj)
+{
+	if (list->len >= list->limit)
+		return 0;
+
+	if (! list->items) {
+		list->items = PyMem_Malloc(list->limit * sizeof(PyObject *));
+
+		if (! list->items)
+			return 0;
+	}
+
+	list->items[list->len++] = obj;
+	return 1;
+}
+
+/**
+ * Change how many objects a free list may keep, freeing any beyond the new
+ * limit.
+ **/
+static int
+AsonFreeList_set_limit(AsonFreeList *list, Py_ssize_t limit)
+{
+	PyObject **items;
+
+	while (list->len > limit)
+		PyObject_Del(list->items[--list->len]);
+
+	if (! limit) {
+		PyMem_Free(list->items);
+		list->items = NULL;
+	} else if (list->items) {
+		items = PyMem_Realloc(list->items, limit * sizeof(PyObject *));
+
+		if (! items) {
+			PyErr_NoMemory();
+			return -1;
+		}
+
+		list->items = items;
+	}
+
+	list->limit = limit;
+	return 0;
+}
+
+/**
+ * Free every object on a free list, and the list itself. The limit is kept.
+ **/
+static void
+AsonFreeList_clear(AsonFreeList *list)
+{
+	while (list->len)
+		PyObject_Del(list->items[--list->len]);
+
+	PyMem_Free(list->items);
+	list->items = NULL;
 }
 
 /**
@@ -137,7 +493,14 @@ PyStringType_AsUTF8(PyObject *obj)
 static void
 Ason_dealloc(Ason *self)
 {
+	Ason_clear_index(self);
 	ason_destroy(self->value);
+	Py_XDECREF(self->source);
+
+	if (Py_TYPE(self) == &ason_AsonType &&
+	    AsonFreeList_push(&ason_free_list, (PyObject *)self))
+		return;
+
 	Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
@@ -147,7 +510,76 @@ Ason_dealloc(Ason *self)
 static void
 AsonIter_dealloc(AsonIter *self)
 {
-	ason_iter_destroy(self->iter);
+	if (self->iter)
+		ason_iter_destroy(self->iter);
+
+	Py_XDECREF(self->lazy);
+	Py_XDECREF(self->result);
+
+	if (Py_TYPE(self) == &ason_AsonIterType &&
+	    AsonFreeList_push(&iter_free_list, (PyObject *)self))
+		return;
+
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * Destroy an AsonTemplate python object.
+ **/
+static void
+AsonTemplate_dealloc(AsonTemplate *self)
+{
+	PyMem_Free(self->text);
+
+	if (self->ns)
+		ason_ns_destroy(self->ns);
+
+	Py_XDECREF(self->variables);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * Destroy an AsonReader python object.
+ **/
+static void
+AsonReader_dealloc(AsonReader *self)
+{
+	Py_XDECREF(self->source);
+	PyMem_Free(self->data);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * Destroy an AsonMatcher python object.
+ **/
+static void
+AsonMatcher_dealloc(AsonMatcher *self)
+{
+	int i;
+
+	ason_destroy(self->schema);
+
+	for (i = 0; i < ASON_MATCHER_FAMILIES; i++)
+		ason_destroy(self->families[i]);
+
+	Py_XDECREF(self->cache);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * Destroy an AsonPath python object.
+ **/
+static void
+AsonPath_dealloc(AsonPath *self)
+{
+	Py_ssize_t i;
+
+	for (i = 0; i < self->n_nodes; i++)
+		Py_XDECREF(self->nodes[i].key);
+
+	PyMem_Free(self->nodes);
+	PyMem_Free(self->ends);
+	Py_XDECREF(self->expressions);
 	Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
@@ -159,11 +591,25 @@ Ason_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
 	Ason *self;
 
-	self = (Ason *)type->tp_alloc(type, 0);
+	if (type == &ason_AsonType)
+		self = (Ason *)AsonFreeList_pop(&ason_free_list, type);
+	else
+		self = (Ason *)type->tp_alloc(type, 0);
+
 	if (self == NULL)
 		return NULL;
 
 	self->value = ASON_EMPTY;
+	self->hash = -1;
+	self->source = NULL;
+	self->start = 0;
+	self->len = 0;
+	self->kind = -1;
+	self->index = NULL;
+	self->index_len = -1;
+	self->index_source = NULL;
+	self->index_iter = NULL;
+	self->index_pos = 0;
 
 	return (PyObject *)self;
 }
@@ -176,7 +622,11 @@ AsonIter_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
 	AsonIter *self;
 
-	self = (AsonIter *)type->tp_alloc(type, 0);
+	if (type == &ason_AsonIterType)
+		self = (AsonIter *)AsonFreeList_pop(&iter_free_list, type);
+	else
+		self = (AsonIter *)type->tp_alloc(type, 0);
+
 	if (self == NULL)
 		return NULL;
 
@@ -185,73 +635,217 @@ AsonIter_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 	self->halt = 0;
 	self->enter_union = 0;
 	self->in_object = 0;
+	self->mode = ASON_ITER_ITEMS;
+	self->plain = 0;
+	self->result = NULL;
+	self->lazy = NULL;
 
 	return (PyObject *)self;
 }
 
 /**
- * Convert an Ason object to string.
+ * Allocate an AsonTemplate object.
  **/
 static PyObject *
-Ason_str(Ason *self)
+AsonTemplate_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-	char *data;
-	PyObject *ret;
+	AsonTemplate *self;
 
-	if (ason_type(self->value) != ASON_TYPE_STRING) {
-		PyErr_Format(PyExc_TypeError,
-			     "ASON type is not a string");
+	self = (AsonTemplate *)type->tp_alloc(type, 0);
+	if (self == NULL)
 		return NULL;
-	}
 
-	data = ason_string(self->value);
-	ret = Py_BuildValue("s", data);
-	free(data);
-	return ret;
+	self->text = NULL;
+	self->ns = NULL;
+	self->variables = NULL;
+
+	return (PyObject *)self;
 }
 
 /**
- * Programmatic representation of an Ason object
+ * Allocate an AsonReader object.
  **/
 static PyObject *
-Ason_repr(Ason *self)
+AsonReader_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-	char *data = ason_asprint_unicode(self->value);
-	char *repr;
+	AsonReader *self;
 
-	if (asprintf(&repr, "ason(%s)", data) < 0) {
-		PyErr_NoMemory();
+	self = (AsonReader *)type->tp_alloc(type, 0);
+	if (self == NULL)
 		return NULL;
-	}
 
-	PyObject *ret = Py_BuildValue("s", repr);
-	free(data);
-	free(repr);
-	return ret;
+	self->source = NULL;
+	self->fd = -1;
+	self->chunk_size = 65536;
+	self->data = NULL;
+	self->size = 0;
+	self->start = 0;
+	self->len = 0;
+	self->scan = 0;
+	self->depth = 0;
+	self->in_string = 0;
+	self->escape = 0;
+	self->eof = 0;
+	self->busy = 0;
+
+	return (PyObject *)self;
 }
 
-static PyObject * Ason_intersect(Ason *self, Ason *other);
-static PyObject * Ason_union(Ason *self, Ason *other);
-static PyObject * Ason_join(Ason *self, PyObject *args);
-static PyObject * Ason_complement(Ason *self);
-static PyObject * Ason_compare(PyObject *a, PyObject *b, int op);
-static PyObject * AsonIter_next(AsonIter *self);
-static PyObject * Ason_int(Ason *self);
-static PyObject * Ason_is_numeric(Ason *self);
-static PyObject * Ason_is_string(Ason *self);
-static PyObject * Ason_is_list(Ason *self);
-static PyObject * Ason_is_object(Ason *self);
-static PyObject * Ason_is_union(Ason *self);
-static PyObject * Ason_is_complement(Ason *self);
-static PyObject * Ason_iter_union(Ason *self);
-static PyObject * Ason_float(Ason *self);
-static PyObject * Ason_serialize(Ason *self);
+/**
+ * Allocate an AsonMatcher object.
+ **/
+static PyObject *
+AsonMatcher_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	AsonMatcher *self;
+
+	self = (AsonMatcher *)type->tp_alloc(type, 0);
+	if (self == NULL)
+		return NULL;
+
+	memset(self->families, 0, sizeof(self->families));
+	self->schema = NULL;
+	self->cache = NULL;
+	self->cache_size = 0;
+	self->hits = 0;
+	self->misses = 0;
+
+	return (PyObject *)self;
+}
+
+/**
+ * Allocate an AsonPath object.
+ **/
+static PyObject *
+AsonPath_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	AsonPath *self;
+
+	self = (AsonPath *)type->tp_alloc(type, 0);
+	if (self == NULL)
+		return NULL;
+
+	self->nodes = NULL;
+	self->n_nodes = 0;
+	self->ends = NULL;
+	self->n_paths = 0;
+	self->expressions = NULL;
+
+	return (PyObject *)self;
+}
+
+/**
+ * Convert an Ason object to string.
+ **/
+static PyObject *
+Ason_str(Ason *self)
+{
+	ason_t *value = Ason_value(self);
+	char *data;
+	PyObject *ret;
+
+	if (! value)
+		return NULL;
+
+	if (ason_type(value) != ASON_TYPE_STRING) {
+		PyErr_Format(PyExc_TypeError,
+			     "ASON type is not a string");
+		return NULL;
+	}
+
+	data = ason_string(value);
+	ret = Py_BuildValue("s", data);
+	free(data);
+	return ret;
+}
+
+/**
+ * Programmatic representation of an Ason object
+ **/
+static PyObject *
+Ason_repr(Ason *self)
+{
+	ason_t *value = Ason_value(self);
+	char *data;
+	PyObject *ret;
+
+	if (! value)
+		return NULL;
+
+	data = ason_asprint_unicode(value);
+
+	if (! data)
+		return PyErr_NoMemory();
+
+#ifdef PYTHON2
+	ret = PyString_FromFormat("ason(%s)", data);
+#else
+	ret = PyUnicode_FromFormat("ason(%s)", data);
+#endif
+	free(data);
+	return ret;
+}
+
+static PyObject * Ason_intersect(Ason *self, Ason *other);
+static PyObject * Ason_union(Ason *self, Ason *other);
+static PyObject * Ason_join(Ason *self, PyObject *args);
+static PyObject * Ason_complement(Ason *self);
+static PyObject * Ason_compare(PyObject *a, PyObject *b, int op);
+static PyObject * AsonIter_next(AsonIter *self);
+static PyObject * Ason_int(Ason *self);
+static PyObject * Ason_is_numeric(Ason *self);
+static PyObject * Ason_is_string(Ason *self);
+static PyObject * Ason_is_list(Ason *self);
+static PyObject * Ason_is_object(Ason *self);
+static PyObject * Ason_is_union(Ason *self);
+static PyObject * Ason_is_complement(Ason *self);
+static PyObject * Ason_iter_union(Ason *self);
+static PyObject * Ason_keys(Ason *self);
+static PyObject * Ason_values(Ason *self, PyObject *args, PyObject *kwargs);
+static PyObject * Ason_items(Ason *self, PyObject *args, PyObject *kwargs);
+static PyObject * Ason_float(Ason *self);
+static PyObject * Ason_serialize(Ason *self, PyObject *args,
+				 PyObject *kwargs);
+static PyObject * Ason_serialize_bytes(Ason *self, PyObject *args,
+				       PyObject *kwargs);
+static PyObject * Ason_serialize_into(Ason *self, PyObject *args,
+				      PyObject *kwargs);
+static PyObject * Ason_dump(Ason *self, PyObject *args, PyObject *kwargs);
+static Py_hash_t Ason_hash(Ason *self);
+static PyObject * Ason_to_python(Ason *self, PyObject *args,
+				 PyObject *kwargs);
+static PyObject * Ason_to_json(Ason *self, PyObject *args,
+				 PyObject *kwargs);
+
+static Py_ssize_t Ason_length(Ason *self);
+static PyObject * Ason_item(Ason *self, Py_ssize_t i);
+static PyObject * Ason_subscript(Ason *self, PyObject *key);
+static int Ason_contains(Ason *self, PyObject *item);
+static int Ason_bool(Ason *self);
 
 static AsonIter * Ason_iterate(Ason *self);
 static AsonIter * AsonIter_iterate(AsonIter *self);
 
+static PyObject * AsonTemplate_call(AsonTemplate *self, PyObject *args,
+				    PyObject *kwargs);
+static PyObject * AsonReader_feed(AsonReader *self, PyObject *args);
+static PyObject * AsonReader_close(AsonReader *self);
+static PyObject * AsonReader_next(AsonReader *self);
+
 static int Ason_init(Ason *self, PyObject *args, PyObject *kwds);
 static int AsonIter_init(AsonIter *self, PyObject *args, PyObject *kwds);
+static int AsonTemplate_init(AsonTemplate *self, PyObject *args,
+			     PyObject *kwds);
+static int AsonReader_init(AsonReader *self, PyObject *args, PyObject *kwds);
+static PyObject * AsonMatcher_matches(AsonMatcher *self, PyObject *args);
+static PyObject * AsonMatcher_clear_cache(AsonMatcher *self);
+static int AsonMatcher_init(AsonMatcher *self, PyObject *args,
+			    PyObject *kwds);
+static PyObject * AsonPath_call(AsonPath *self, PyObject *args,
+				PyObject *kwargs);
+static int AsonPath_init(AsonPath *self, PyObject *args, PyObject *kwds);
+static PyObject * Ason_reduce_ex(Ason *self, PyObject *args);
+static PyObject * Ason_copy(Ason *self, PyObject *args);
 
 /**
  * Method table for ASON value object.
@@ -270,11 +864,66 @@ static PyMethodDef Ason_methods[] = {
 		"Check whether this is a union ASON value"},
 	{"is_complement", (PyCFunction)Ason_is_complement, METH_NOARGS,
 		"Check whether this is a complement ASON value"},
-	{"serialize", (PyCFunction)Ason_serialize, METH_NOARGS,
-		"Return the ASON-formatted string representation of this value"},
+	{"serialize", (PyCFunction)Ason_serialize,
+		METH_VARARGS | METH_KEYWORDS,
+		"Return the ASON-formatted string representation of this "
+		"value. If ``unicode`` is false, plain ASCII operators are "
+		"used instead of Unicode symbols such as ``∪``"},
+	{"serialize_bytes", (PyCFunction)Ason_serialize_bytes,
+		METH_VARARGS | METH_KEYWORDS,
+		"Like :py:meth:`serialize`, but return UTF-8 encoded "
+		":py:class:`bytes`"},
+	{"serialize_into", (PyCFunction)Ason_serialize_into,
+		METH_VARARGS | METH_KEYWORDS,
+		"Write the UTF-8 encoded ASON representation of this value "
+		"into a writable buffer such as a :py:class:`bytearray`, "
+		"starting at ``offset``, and return the number of bytes "
+		"written. Raises :py:exc:`ValueError` if it does not fit"},
+	{"dump", (PyCFunction)Ason_dump, METH_VARARGS | METH_KEYWORDS,
+		"Write the UTF-8 encoded ASON representation of this value to "
+		"a binary file-like object in chunks of at most "
+		"``chunk_size`` bytes, and return the number of bytes "
+		"written"},
+	{"__reduce_ex__", (PyCFunction)Ason_reduce_ex, METH_VARARGS,
+		"Support for pickling. Values are pickled in the binary "
+		"encoding used by :py:func:`dumpb`"},
+	{"__copy__", (PyCFunction)Ason_copy, METH_NOARGS,
+		"Return this value, which is immutable"},
+	{"__deepcopy__", (PyCFunction)Ason_copy, METH_VARARGS,
+		"Return this value, which is immutable"},
 	{"iter_union", (PyCFunction)Ason_iter_union, METH_NOARGS,
 		"Return an iterator that will iterate over individual items "
 		"in a union"},
+	{"keys", (PyCFunction)Ason_keys, METH_NOARGS,
+		"Return an iterator over the keys of an object. No "
+		":py:class:`ason` objects are made for the values"},
+	{"values", (PyCFunction)Ason_values, METH_VARARGS | METH_KEYWORDS,
+		"Return an iterator over the values of an object or the "
+		"items of a list. If ``plain`` is true, nulls, booleans, "
+		"numbers and strings are given as Python values rather than "
+		":py:class:`ason` objects"},
+	{"items", (PyCFunction)Ason_items, METH_VARARGS | METH_KEYWORDS,
+		"Return an iterator over the ``(key, value)`` fields of an "
+		"object. ``plain`` is as for :py:meth:`values`"},
+	{"to_python", (PyCFunction)Ason_to_python,
+		METH_VARARGS | METH_KEYWORDS,
+		"Convert this value to plain Python data in one pass. Lists, "
+		"objects, strings, numbers, booleans and null become "
+		":py:class:`list`, :py:class:`dict`, :py:class:`str`, "
+		":py:class:`int` or :py:class:`float`, :py:class:`bool` and "
+		"``None``. Any other value (unions, complements, universal "
+		"objects, wild, etc.) is handled according to ``fallback``: "
+		"``'error'`` raises :py:exc:`TypeError`, ``'ason'`` leaves it "
+		"as an :py:class:`ason` object and ``'string'`` gives its "
+		"serialized ASON text."},
+	{"to_json", (PyCFunction)Ason_to_json, METH_VARARGS | METH_KEYWORDS,
+		"Return this value as compact JSON text, written in one pass "
+		"without making Python objects for its members. Values with "
+		"no JSON form (unions, complements, universal objects, wild, "
+		"non-finite numbers, etc.) are handled according to "
+		"``fallback``: ``'error'`` raises :py:exc:`TypeError`, "
+		"``'string'`` writes their serialized ASON text as a JSON "
+		"string and ``'null'`` writes ``null``."},
 	{NULL}
 };
 
@@ -284,6 +933,22 @@ static PyNumberMethods ason_AsonNumber = {
 	.nb_invert = (unaryfunc)Ason_complement,
 	.nb_int = (unaryfunc)Ason_int,
 	.nb_float = (unaryfunc)Ason_float,
+#ifdef PYTHON2
+	.nb_nonzero = (inquiry)Ason_bool,
+#else
+	.nb_bool = (inquiry)Ason_bool,
+#endif
+};
+
+static PySequenceMethods ason_AsonSequence = {
+	.sq_length = (lenfunc)Ason_length,
+	.sq_item = (ssizeargfunc)Ason_item,
+	.sq_contains = (objobjproc)Ason_contains,
+};
+
+static PyMappingMethods ason_AsonMapping = {
+	.mp_length = (lenfunc)Ason_length,
+	.mp_subscript = (binaryfunc)Ason_subscript,
 };
 
 /**
@@ -308,9 +973,9 @@ static PyTypeObject ason_AsonType = {
 	0,
 	(reprfunc)Ason_repr,
 	&ason_AsonNumber,
-	0,
-	0,
-	0,
+	&ason_AsonSequence,
+	&ason_AsonMapping,
+	(hashfunc)Ason_hash,
 	0,
 	(reprfunc)Ason_str,
 	0,
@@ -382,564 +1047,7052 @@ static PyTypeObject ason_AsonIterType = {
 };
 
 /**
- * Convert a python value to an ASON value.
+ * Attributes of AsonTemplate object.
  **/
-static ason_t *
-pyobject_to_ason(PyObject *obj)
-{
-	PyObject *item;
-	PyObject *key;
-	int64_t ival;
-	uint64_t uval;
-	double dval;
-	ssize_t size;
-	char *list_data;
-	char *str_key;
-	ason_t *tmp1;
-	ason_t *tmp2;
-	ason_t *ret;
-	Py_ssize_t i;
-
-	sweep_strings();
-
-	if (PyStringType_Check(obj)) {
-		str_key = PyStringType_AsUTF8(obj);
-
-		if (! str_key)
-			return NULL;
-
-		return ason_read("?s", str_key);
-	}
-retry:
-	if (PyBool_Check(obj)) {
-		if (obj == Py_False)
-			return  ASON_FALSE;
-		else
-			return  ASON_TRUE;
-	}
-
-	if (obj == Py_None)
-		return ASON_NULL;
+static PyMemberDef AsonTemplate_members[] = {
+	{"variables", T_OBJECT, offsetof(AsonTemplate, variables), READONLY,
+		"Names of the variables the template expects, in order of "
+		"first appearance"},
+	{NULL}
+};
 
-	if (PyLong_Check(obj)) {
-		ival = PyLong_AsLongLong(obj);
-#ifdef PYTHON2
-parselong:
-#endif
-		if (! PyErr_Occurred())
-			return ason_read("?I", ival);
+/**
+ * Type for AsonTemplate object.
+ **/
+static PyTypeObject ason_AsonTemplateType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"ason.AsonTemplate",
+	sizeof(AsonTemplate),
+	0,
+	(destructor)AsonTemplate_dealloc,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	(ternaryfunc)AsonTemplate_call,
+	0,
+	0,
+	0,
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	"An ASON expression with its variables made in a namespace of its "
+	"own. Call it with keyword arguments to bind its variables and get "
+	"an ASON value",
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	AsonTemplate_members,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	(initproc)AsonTemplate_init,
+	0,
+	AsonTemplate_new
+};
 
-		PyErr_Clear();
-		uval = PyLong_AsUnsignedLongLong(obj);
+/**
+ * Method table for AsonReader object.
+ **/
+static PyMethodDef AsonReader_methods[] = {
+	{"feed", (PyCFunction)AsonReader_feed, METH_VARARGS,
+		"Add a chunk of input to the reader"},
+	{"close", (PyCFunction)AsonReader_close, METH_NOARGS,
+		"Mark the end of input, so a final value without a trailing "
+		"newline is returned by the next iteration"},
+	{NULL}
+};
 
-		if (PyErr_Occurred())
-			return NULL;
+/**
+ * Type for AsonReader object.
+ **/
+static PyTypeObject ason_AsonReaderType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"ason.AsonReader",
+	sizeof(AsonReader),
+	0,
+	(destructor)AsonReader_dealloc,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	"Reads a stream of ASON values separated by newlines. Newlines "
+	"inside strings and brackets are part of the value, but outside "
+	"them each value must fit on one line. Only one value is buffered "
+	"at a time",
+	0,
+	0,
+	0,
+	0,
+	PyObject_SelfIter,
+	(iternextfunc)AsonReader_next,
+	AsonReader_methods,
+	0, /* members */
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	(initproc)AsonReader_init,
+	0,
+	AsonReader_new
+};
 
-		return ason_read("?U", uval);
-	}
+/**
+ * Method table for AsonMatcher object.
+ **/
+static PyMethodDef AsonMatcher_methods[] = {
+	{"matches", (PyCFunction)AsonMatcher_matches, METH_VARARGS,
+		"Check whether a value is represented in the schema. "
+		"Equivalent to ``value <= schema``"},
+	{"clear_cache", (PyCFunction)AsonMatcher_clear_cache, METH_NOARGS,
+		"Forget all cached results"},
+	{NULL}
+};
 
-	if (PyFloat_Check(obj)) {
-		dval = PyFloat_AsDouble(obj);
+/**
+ * Attributes of AsonMatcher object.
+ **/
+static PyMemberDef AsonMatcher_members[] = {
+	{"hits", T_PYSSIZET, offsetof(AsonMatcher, hits), READONLY,
+		"Number of checks answered from the result cache"},
+	{"misses", T_PYSSIZET, offsetof(AsonMatcher, misses), READONLY,
+		"Number of checks that had to be computed"},
+	{NULL}
+};
 
-		if (PyErr_Occurred())
-			return NULL;
+/**
+ * Type for AsonMatcher object.
+ **/
+static PyTypeObject ason_AsonMatcherType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"ason.AsonMatcher",
+	sizeof(AsonMatcher),
+	0,
+	(destructor)AsonMatcher_dealloc,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	"A schema prepared for repeated ``value <= schema`` checks",
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	AsonMatcher_methods,
+	AsonMatcher_members,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	(initproc)AsonMatcher_init,
+	0,
+	AsonMatcher_new
+};
 
-		return ason_read("?F", dval);
-	}
+/**
+ * Attributes of AsonPath object.
+ **/
+static PyMemberDef AsonPath_members[] = {
+	{"expressions", T_OBJECT, offsetof(AsonPath, expressions), READONLY,
+		"The path expressions this was compiled from"},
+	{NULL}
+};
 
-#ifdef PYTHON2
-	if (PyInt_Check(obj)) {
-		ival = PyInt_AsLong(obj);
-		goto parselong;
+/**
+ * Type for AsonPath object.
+ **/
+static PyTypeObject ason_AsonPathType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"ason.AsonPath",
+	sizeof(AsonPath),
+	0,
+	(destructor)AsonPath_dealloc,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	(ternaryfunc)AsonPath_call,
+	0,
+	0,
+	0,
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	"One or more compiled path expressions",
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	AsonPath_members,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	(initproc)AsonPath_init,
+	0,
+	AsonPath_new
+};
+
+/**
+ * Make a new Ason object with no value yet. Everything that creates Ason
+ * objects directly goes through here so cached state starts out clear.
+ **/
+static Ason *
+Ason_alloc(void)
+{
+	Ason *self = (Ason *)AsonFreeList_pop(&ason_free_list,
+					      &ason_AsonType);
+
+	if (! self)
+		return NULL;
+
+	self->value = NULL;
+	self->hash = -1;
+	self->source = NULL;
+	self->start = 0;
+	self->len = 0;
+	self->kind = -1;
+	self->index = NULL;
+	self->index_len = -1;
+	self->index_source = NULL;
+	self->index_iter = NULL;
+	self->index_pos = 0;
+	return self;
+}
+
+/**
+ * Get the text backing a lazily parsed Ason object.
+ **/
+static const char *
+lazy_text(PyObject *source)
+{
+	if (PyBytes_Check(source))
+		return PyBytes_AS_STRING(source);
+
+#ifdef PYTHON2
+	return NULL;
+#else
+	return PyUnicode_AsUTF8(source);
+#endif
+}
+
+/**
+ * Scan unparsed ASON text from `pos` for the first of the `stops` characters
+ * outside any string or bracket, or for an unmatched closing bracket.
+ * Returns its position, or `end` if there is none.
+ **/
+static size_t
+lazy_scan(const char *text, size_t pos, size_t end, const char *stops)
+{
+	int depth = 0;
+	char c;
+
+	for (; pos < end; pos++) {
+		c = text[pos];
+
+		if (c == '"') {
+			for (pos++; pos < end && text[pos] != '"'; pos++)
+				if (text[pos] == '\\')
+					pos++;
+		} else if (c == '[' || c == '{' || c == '(') {
+			depth++;
+		} else if (c == ']' || c == '}' || c == ')') {
+			if (! depth)
+				return pos;
+
+			depth--;
+		} else if (! depth && strchr(stops, c)) {
+			return pos;
+		}
+	}
+
+	return end;
+}
+
+/**
+ * Trim whitespace from both ends of a span of text.
+ **/
+static void
+lazy_trim(const char *text, size_t *start, size_t *end)
+{
+	while (*start < *end && isspace((unsigned char)text[*start]))
+		(*start)++;
+
+	while (*end > *start && isspace((unsigned char)text[*end - 1]))
+		(*end)--;
+}
+
+/**
+ * Work out what type of value a span of unparsed text holds, without parsing
+ * it. Only a single literal can be classified; anything else (expressions,
+ * variables, Unicode operators) gives -1.
+ **/
+static int
+lazy_classify(const char *text, size_t start, size_t end)
+{
+	size_t pos;
+	size_t last;
+
+	lazy_trim(text, &start, &end);
+
+	if (start == end)
+		return -1;
+
+	switch (text[start]) {
+	case '[':
+		if (lazy_scan(text, start + 1, end, "") != end - 1 ||
+		    text[end - 1] != ']')
+			return -1;
+
+		return ASON_TYPE_LIST;
+	case '{':
+		if (lazy_scan(text, start + 1, end, "") != end - 1 ||
+		    text[end - 1] != '}')
+			return -1;
+
+		/* A trailing * makes it a universal object */
+		last = end - 1;
+
+		for (pos = start + 1; pos < end - 1;
+		     pos = lazy_scan(text, pos, end - 1, ",") + 1)
+			last = pos;
+
+		pos = end - 1;
+		lazy_trim(text, &last, &pos);
+
+		if (pos == last + 1 && text[last] == '*')
+			return ASON_TYPE_UOBJECT;
+
+		return ASON_TYPE_OBJECT;
+	case '"':
+		for (pos = start + 1; pos < end && text[pos] != '"'; pos++)
+			if (text[pos] == '\\')
+				pos++;
+
+		return pos == end - 1 ? ASON_TYPE_STRING : -1;
+	default:
+		break;
+	}
+
+	if (end - start == 4 && ! memcmp(text + start, "null", 4))
+		return ASON_TYPE_NULL;
+	if (end - start == 4 && ! memcmp(text + start, "true", 4))
+		return ASON_TYPE_TRUE;
+	if (end - start == 5 && ! memcmp(text + start, "false", 5))
+		return ASON_TYPE_FALSE;
+
+	if (! isdigit((unsigned char)text[start]) && text[start] != '-')
+		return -1;
+
+	for (pos = start; pos < end; pos++)
+		if (! strchr("0123456789+-.eE", text[pos]))
+			return -1;
+
+	return ASON_TYPE_NUMERIC;
+}
+
+/**
+ * Make an Ason object for a span of unparsed text.
+ **/
+static Ason *
+Ason_lazy(PyObject *source, size_t start, size_t end)
+{
+	const char *text = lazy_text(source);
+	Ason *ret;
+
+	if (! text)
+		return NULL;
+
+	lazy_trim(text, &start, &end);
+	ret = Ason_alloc();
+
+	if (! ret)
+		return NULL;
+
+	Py_INCREF(source);
+	ret->source = source;
+	ret->start = start;
+	ret->len = end - start;
+	ret->kind = lazy_classify(text, start, end);
+	return ret;
+}
+
+/**
+ * Get the ASON value of an Ason object, parsing it now if it was parsed
+ * lazily.
+ **/
+static ason_t *
+Ason_value(Ason *self)
+{
+	const char *text;
+	ason_t *value;
+	char *copy;
+
+	if (! self->source)
+		return self->value;
+
+	text = lazy_text(self->source);
+
+	if (! text)
+		return NULL;
+
+	copy = PyMem_Malloc(self->len + 1);
+
+	if (! copy) {
+		PyErr_NoMemory();
+		return NULL;
+	}
+
+	memcpy(copy, text + self->start, self->len);
+	copy[self->len] = '\0';
+
+	Py_BEGIN_ALLOW_THREADS
+	value = ason_ns_read(NULL, copy);
+	Py_END_ALLOW_THREADS
+
+	PyMem_Free(copy);
+
+	if (! value) {
+		PyErr_Format(PyExc_TypeError,
+			     "Could not parse ASON expression");
+		return NULL;
+	}
+
+	/* Another thread may have got there while we parsed */
+	if (! self->source) {
+		ason_destroy(value);
+		return self->value;
+	}
+
+	self->value = value;
+	Py_CLEAR(self->source);
+	return self->value;
+}
+
+/**
+ * Copy the ASON value of an Ason object, parsing it first if need be.
+ **/
+static ason_t *
+ason_copy_of(Ason *self)
+{
+	ason_t *value = Ason_value(self);
+
+	return value ? ason_copy(value) : NULL;
+}
+
+/**
+ * Get the ASON type of an Ason object, without parsing it if it was parsed
+ * lazily and the type can be told from its text. Returns -1 on error.
+ **/
+static int
+Ason_get_type(Ason *self)
+{
+	ason_t *value;
+
+	if (self->source && self->kind >= 0)
+		return self->kind;
+
+	value = Ason_value(self);
+
+	if (! value)
+		return -1;
+
+	return ason_type(value);
+}
+
+/**
+ * Read four hex digits, or return -1 if they aren't.
+ **/
+static long
+lazy_hex4(const char *text)
+{
+	long ret = 0;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		if (! isxdigit((unsigned char)text[i]))
+			return -1;
+
+		ret = ret * 16 + (isdigit((unsigned char)text[i]) ?
+				  text[i] - '0' :
+				  tolower((unsigned char)text[i]) - 'a' + 10);
+	}
+
+	return ret;
+}
+
+/**
+ * Decode a quoted string literal from unparsed ASON text to UTF-8. Returns a
+ * NUL-terminated buffer to be freed with PyMem_Free, and its length in
+ * `out_len`.
+ **/
+static char *
+lazy_unescape(const char *text, size_t len, size_t *out_len)
+{
+	static const char simple[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+	const char *end = text + len - 1;
+	const char *c;
+	long code;
+	long low;
+	char *buf;
+	char *out;
+	int i;
+
+	text++;
+
+	/* Escapes never grow when decoded to UTF-8 */
+	buf = PyMem_Malloc(end - text + 1);
+
+	if (! buf) {
+		PyErr_NoMemory();
+		return NULL;
+	}
+
+	for (out = buf; text < end; text++) {
+		if (*text != '\\') {
+			*out++ = *text;
+			continue;
+		}
+
+		text++;
+
+		for (c = simple; *c && *c != *text; c += 2);
+
+		if (*c) {
+			*out++ = c[1];
+			continue;
+		}
+
+		if (*text != 'u' || end - text < 5 || lazy_hex4(text + 1) < 0)
+			goto bad;
+
+		code = lazy_hex4(text + 1);
+		text += 4;
+
+		if (code >= 0xd800 && code < 0xdc00 && end - text >= 7 &&
+		    text[1] == '\\' && text[2] == 'u') {
+			low = lazy_hex4(text + 3);
+
+			if (low >= 0xdc00 && low < 0xe000) {
+				code = 0x10000 + ((code - 0xd800) << 10) +
+					(low - 0xdc00);
+				text += 6;
+			}
+		}
+
+		if (code < 0x80) {
+			*out++ = code;
+		} else if (code < 0x800) {
+			*out++ = 0xc0 | (code >> 6);
+			*out++ = 0x80 | (code & 0x3f);
+		} else if (code < 0x10000) {
+			*out++ = 0xe0 | (code >> 12);
+			*out++ = 0x80 | ((code >> 6) & 0x3f);
+			*out++ = 0x80 | (code & 0x3f);
+		} else {
+			*out++ = 0xf0 | (code >> 18);
+			for (i = 12; i >= 0; i -= 6)
+				*out++ = 0x80 | ((code >> i) & 0x3f);
+		}
+	}
+
+	*out = '\0';
+	*out_len = out - buf;
+	return buf;
+
+bad:
+	PyMem_Free(buf);
+	PyErr_Format(PyExc_TypeError, "Could not parse ASON expression");
+	return NULL;
+}
+
+/**
+ * Convert a quoted string literal from unparsed ASON text to a Python string.
+ **/
+static PyObject *
+lazy_string(const char *text, size_t len)
+{
+	PyObject *ret;
+	size_t out_len;
+	char *buf;
+
+	if (! memchr(text + 1, '\\', len - 2))
+		return PyStringType_FromStringAndSize(text + 1, len - 2);
+
+	buf = lazy_unescape(text, len, &out_len);
+
+	if (! buf)
+		return NULL;
+
+	ret = PyStringType_FromStringAndSize(buf, out_len);
+	PyMem_Free(buf);
+	return ret;
+}
+
+/**
+ * Drop the member index of an Ason object.
+ **/
+static void
+Ason_clear_index(Ason *self)
+{
+	Py_ssize_t i;
+
+	for (i = 0; self->index && i < self->index_len; i++) {
+		PyMem_Free(self->index[i].key);
+		Py_XDECREF(self->index[i].child);
+	}
+
+	PyMem_Free(self->index);
+	Py_CLEAR(self->index_source);
+
+	if (self->index_iter)
+		ason_iter_destroy(self->index_iter);
+
+	self->index = NULL;
+	self->index_len = -1;
+	self->index_iter = NULL;
+}
+
+/**
+ * Order index entries by key. Among equal keys the later one sorts last, so
+ * lookups can take the last match like the parser does.
+ **/
+static int
+AsonIndexEntry_compare(const void *a, const void *b)
+{
+	const AsonIndexEntry *x = a;
+	const AsonIndexEntry *y = b;
+	size_t len = x->key_len < y->key_len ? x->key_len : y->key_len;
+	int ret = memcmp(x->key, y->key, len);
+
+	if (ret)
+		return ret;
+
+	if (x->key_len != y->key_len)
+		return x->key_len < y->key_len ? -1 : 1;
+
+	return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/**
+ * Add an entry to an index under construction.
+ **/
+static AsonIndexEntry *
+Ason_index_add(Ason *self, size_t *size)
+{
+	AsonIndexEntry *index = self->index;
+	AsonIndexEntry *ret;
+
+	if ((size_t)self->index_len == *size) {
+		*size = *size ? *size * 2 : 8;
+		index = PyMem_Realloc(index, *size * sizeof(AsonIndexEntry));
+
+		if (! index) {
+			PyErr_NoMemory();
+			return NULL;
+		}
+
+		self->index = index;
+	}
+
+	ret = &index[self->index_len++];
+	memset(ret, 0, sizeof(*ret));
+	ret->order = self->index_len;
+	return ret;
+}
+
+/**
+ * Index the members of a lazily parsed list or object from its text.
+ **/
+static int
+Ason_index_lazy(Ason *self, size_t *size)
+{
+	const char *text = lazy_text(self->source);
+	int in_object = self->kind != ASON_TYPE_LIST;
+	size_t end = self->start + self->len - 1;
+	size_t pos = self->start + 1;
+	size_t start;
+	size_t stop;
+	size_t next;
+	size_t colon;
+	size_t key_end;
+	AsonIndexEntry *entry;
+
+	if (! text)
+		return -1;
+
+	Py_INCREF(self->source);
+	self->index_source = self->source;
+
+	for (; pos < end; pos = next + 1) {
+		next = lazy_scan(text, pos, end, ",");
+		start = pos;
+		stop = next;
+		lazy_trim(text, &start, &stop);
+
+		/* The * of a universal object isn't a member */
+		if (start == stop ||
+		    (in_object && stop - start == 1 && text[start] == '*'))
+			continue;
+
+		entry = Ason_index_add(self, size);
+
+		if (! entry)
+			return -1;
+
+		entry->start = start;
+		entry->end = stop;
+
+		if (! in_object)
+			continue;
+
+		colon = lazy_scan(text, start, entry->end, ":");
+		key_end = colon;
+		lazy_trim(text, &start, &key_end);
+
+		if (colon >= entry->end || key_end - start < 2 ||
+		    text[start] != '"' || text[key_end - 1] != '"') {
+			PyErr_Format(PyExc_TypeError,
+				     "Could not parse ASON expression");
+			return -1;
+		}
+
+		entry->key = lazy_unescape(text + start, key_end - start,
+					   &entry->key_len);
+
+		if (! entry->key)
+			return -1;
+
+		entry->start = colon + 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Index the members of a parsed list or object by iterating it.
+ **/
+static int
+Ason_index_parsed(Ason *self, ason_t *value, int in_object, size_t *size)
+{
+	ason_iter_t *iter = ason_iterate(value);
+	AsonIndexEntry *entry;
+	char *key;
+	int got;
+
+	if (! iter) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	for (got = ason_iter_enter(iter); got; got = ason_iter_next(iter)) {
+		entry = Ason_index_add(self, size);
+
+		if (! entry)
+			goto fail;
+
+		if (! in_object)
+			continue;
+
+		key = ason_iter_key(iter);
+
+		if (! key) {
+			PyErr_NoMemory();
+			goto fail;
+		}
+
+		entry->key_len = strlen(key);
+		entry->key = PyMem_Malloc(entry->key_len + 1);
+
+		if (entry->key)
+			memcpy(entry->key, key, entry->key_len + 1);
+
+		free(key);
+
+		if (! entry->key) {
+			PyErr_NoMemory();
+			goto fail;
+		}
+	}
+
+	ason_iter_destroy(iter);
+	return 0;
+
+fail:
+	ason_iter_destroy(iter);
+	return -1;
+}
+
+/**
+ * Build the member index for a list, object or union (whose members are its
+ * alternatives), if we haven't yet. Lazily parsed values are indexed straight
+ * from their text without parsing any of the members. Returns the ASON type,
+ * or -1 on error.
+ **/
+static int
+Ason_index(Ason *self)
+{
+	int type = Ason_get_type(self);
+	ason_t *value;
+	size_t size = 0;
+	int ret;
+
+	if (type < 0 || self->index_len >= 0)
+		return type;
+
+	if (type != ASON_TYPE_LIST && type != ASON_TYPE_OBJECT &&
+	    type != ASON_TYPE_UOBJECT && type != ASON_TYPE_UNION)
+		return type;
+
+	self->index_len = 0;
+
+	if (self->source) {
+		ret = Ason_index_lazy(self, &size);
+	} else {
+		value = Ason_value(self);
+		ret = value ? Ason_index_parsed(self, value,
+						type == ASON_TYPE_OBJECT ||
+						type == ASON_TYPE_UOBJECT,
+						&size) : -1;
+	}
+
+	if (ret < 0) {
+		Ason_clear_index(self);
+		return -1;
+	}
+
+	if (type == ASON_TYPE_OBJECT || type == ASON_TYPE_UOBJECT)
+		qsort(self->index, self->index_len, sizeof(AsonIndexEntry),
+		      AsonIndexEntry_compare);
+
+	return type;
+}
+
+/**
+ * Get the member of a parsed value at a position in its index. A cursor is
+ * kept on the member last fetched, so walking the members in order costs one
+ * step each.
+ **/
+static ason_t *
+Ason_index_value(Ason *self, size_t pos)
+{
+	if (! self->index_iter) {
+		self->index_iter = ason_iterate(self->value);
+
+		if (! self->index_iter) {
+			PyErr_NoMemory();
+			return NULL;
+		}
+
+		ason_iter_enter(self->index_iter);
+		self->index_pos = 0;
+	}
+
+	for (; self->index_pos < pos; self->index_pos++)
+		ason_iter_next(self->index_iter);
+
+	for (; self->index_pos > pos; self->index_pos--)
+		ason_iter_prev(self->index_iter);
+
+	return ason_iter_value(self->index_iter);
+}
+
+/**
+ * Get the Ason object for an index entry, making it if need be.
+ **/
+static PyObject *
+Ason_index_child(Ason *self, AsonIndexEntry *entry)
+{
+	ason_t *value;
+	Ason *child;
+
+	if (! entry->child && self->index_source) {
+		entry->child = (PyObject *)Ason_lazy(self->index_source,
+						     entry->start,
+						     entry->end);
+	} else if (! entry->child) {
+		value = Ason_index_value(self, entry->order - 1);
+
+		if (! value)
+			return NULL;
+
+		child = Ason_alloc();
+
+		if (! child) {
+			ason_destroy(value);
+			return NULL;
+		}
+
+		child->value = value;
+		entry->child = (PyObject *)child;
+	}
+
+	Py_XINCREF(entry->child);
+	return entry->child;
+}
+
+/**
+ * Find a key in the index of an object. Returns NULL with no exception set if
+ * it isn't there.
+ **/
+static AsonIndexEntry *
+Ason_index_find(Ason *self, PyObject *key)
+{
+	AsonIndexEntry probe;
+	PyObject *hold;
+	Py_ssize_t low = 0;
+	Py_ssize_t high = self->index_len;
+	Py_ssize_t mid;
+
+	probe.key = PyStringType_AsUTF8(key, &hold);
+
+	if (! probe.key)
+		return NULL;
+
+	probe.key_len = strlen(probe.key);
+	probe.order = (size_t)-1;
+
+	/* Find the last entry not after the probe */
+	while (low < high) {
+		mid = low + (high - low) / 2;
+
+		if (AsonIndexEntry_compare(&self->index[mid], &probe) <= 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low) {
+		probe.order = self->index[low - 1].order;
+
+		if (AsonIndexEntry_compare(&self->index[low - 1], &probe))
+			low = 0;
+	}
+
+	Py_XDECREF(hold);
+	return low ? &self->index[low - 1] : NULL;
+}
+
+/**
+ * Buffer in which we assemble ASON text for a whole Python value so it can be
+ * handed to libason in one read. Values which have no text form of their own
+ * (existing ason objects, non-finite floats, and so on) are parked in a
+ * namespace and referred to by variable name.
+ **/
+typedef struct {
+	char *data;
+	size_t len;
+	size_t size;
+	ason_ns_t *ns;
+	size_t slots;
+} AsonBuilder;
+
+static ason_t * pyobject_to_ason(PyObject *obj);
+static int AsonBuilder_emit_dict(AsonBuilder *b, PyObject *obj,
+				 int universal);
+
+/**
+ * Set up an empty builder with room for about `hint` bytes.
+ **/
+static int
+AsonBuilder_init(AsonBuilder *b, size_t hint)
+{
+	if (hint < 64)
+		hint = 64;
+
+	b->data = malloc(hint);
+	b->len = 0;
+	b->size = hint;
+	b->ns = NULL;
+	b->slots = 0;
+
+	if (b->data)
+		return 0;
+
+	PyErr_NoMemory();
+	return -1;
+}
+
+/**
+ * Release everything a builder holds.
+ **/
+static void
+AsonBuilder_clear(AsonBuilder *b)
+{
+	free(b->data);
+	ason_ns_destroy(b->ns);
+	b->data = NULL;
+	b->ns = NULL;
+}
+
+/**
+ * Make sure there is room for `count` more bytes plus a terminator.
+ **/
+static int
+AsonBuilder_reserve(AsonBuilder *b, size_t count)
+{
+	size_t size = b->size;
+	char *data;
+
+	if (b->len + count + 1 <= size)
+		return 0;
+
+	while (b->len + count + 1 > size)
+		size *= 2;
+
+	data = realloc(b->data, size);
+
+	if (! data) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	b->data = data;
+	b->size = size;
+	return 0;
+}
+
+/**
+ * Append raw text to a builder.
+ **/
+static int
+AsonBuilder_put(AsonBuilder *b, const char *text, size_t count)
+{
+	if (AsonBuilder_reserve(b, count) < 0)
+		return -1;
+
+	memcpy(b->data + b->len, text, count);
+	b->len += count;
+	return 0;
+}
+
+/**
+ * Append a single character to a builder.
+ **/
+static int
+AsonBuilder_putc(AsonBuilder *b, char c)
+{
+	if (AsonBuilder_reserve(b, 1) < 0)
+		return -1;
+
+	b->data[b->len++] = c;
+	return 0;
+}
+
+/**
+ * Append a quoted, escaped string literal to a builder.
+ **/
+static int
+AsonBuilder_put_string(AsonBuilder *b, const char *str, size_t count)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned char c;
+	size_t i;
+	char *out;
+
+	/* Worst case every byte becomes a six byte \u escape */
+	if (AsonBuilder_reserve(b, count * 6 + 2) < 0)
+		return -1;
+
+	out = b->data + b->len;
+	*out++ = '"';
+
+	for (i = 0; i < count; i++) {
+		c = str[i];
+
+		switch (c) {
+		case '"':
+		case '\\':
+			*out++ = '\\';
+			*out++ = c;
+			break;
+		case '\n':
+			*out++ = '\\';
+			*out++ = 'n';
+			break;
+		case '\r':
+			*out++ = '\\';
+			*out++ = 'r';
+			break;
+		case '\t':
+			*out++ = '\\';
+			*out++ = 't';
+			break;
+		default:
+			if (c >= 0x20) {
+				*out++ = c;
+				break;
+			}
+
+			*out++ = '\\';
+			*out++ = 'u';
+			*out++ = '0';
+			*out++ = '0';
+			*out++ = hex[c >> 4];
+			*out++ = hex[c & 0xf];
+		}
+	}
+
+	*out++ = '"';
+	b->len = out - b->data;
+	return 0;
+}
+
+/**
+ * Park an ASON value in the builder's namespace and append a reference to it.
+ * Takes ownership of `value`.
+ **/
+static int
+AsonBuilder_put_slot(AsonBuilder *b, ason_t *value)
+{
+	char name[32];
+	int len;
+
+	if (! value) {
+		if (! PyErr_Occurred())
+			PyErr_Format(PyExc_RuntimeError,
+				     "Could not build ASON value");
+		return -1;
+	}
+
+	if (! b->ns)
+		b->ns = ason_ns_create(ASON_NS_RAM, NULL);
+
+	if (! b->ns) {
+		ason_destroy(value);
+		PyErr_Format(PyExc_RuntimeError,
+			     "Could not create ASON namespace");
+		return -1;
+	}
+
+	len = snprintf(name, sizeof(name), "v%zu", b->slots++);
+
+	if (ason_ns_mkvar(b->ns, name)) {
+		ason_destroy(value);
+		PyErr_Format(PyExc_RuntimeError,
+			     "mkvar error from ASON namespace");
+		return -1;
+	}
+
+	if (ason_ns_store(b->ns, name, value)) {
+		ason_destroy(value);
+		PyErr_Format(PyExc_RuntimeError,
+			     "store error from ASON namespace");
+		return -1;
+	}
+
+	return AsonBuilder_put(b, name, len);
+}
+
+/**
+ * Append the ASON text for a python value to a builder.
+ **/
+static int
+AsonBuilder_emit(AsonBuilder *b, PyObject *obj)
+{
+	PyObject *item;
+	PY_LONG_LONG ival;
+	unsigned PY_LONG_LONG uval;
+	double dval;
+	char num[32];
+	char *str;
+	Py_ssize_t i;
+	int len;
+	int ret;
+
+	if (obj == Py_None)
+		return AsonBuilder_put(b, "null", 4);
+
+	if (PyBool_Check(obj)) {
+		if (obj == Py_True)
+			return AsonBuilder_put(b, "true", 4);
+		else
+			return AsonBuilder_put(b, "false", 5);
+	}
+
+#ifdef PYTHON2
+	if (PyString_Check(obj))
+		return AsonBuilder_put_string(b, PyString_AS_STRING(obj),
+					      PyString_GET_SIZE(obj));
+
+	if (PyInt_Check(obj)) {
+		len = snprintf(num, sizeof(num), "%ld", PyInt_AS_LONG(obj));
+		return AsonBuilder_put(b, num, len);
+	}
+#endif
+
+	if (PyUnicode_Check(obj)) {
+#ifdef PYTHON2
+		item = PyUnicode_AsUTF8String(obj);
+
+		if (! item)
+			return -1;
+
+		ret = AsonBuilder_put_string(b, PyString_AS_STRING(item),
+					     PyString_GET_SIZE(item));
+		Py_DECREF(item);
+		return ret;
+#else
+		str = (char *)PyUnicode_AsUTF8AndSize(obj, &i);
+
+		if (! str)
+			return -1;
+
+		return AsonBuilder_put_string(b, str, i);
+#endif
+	}
+
+	if (PyLong_Check(obj)) {
+		ival = PyLong_AsLongLong(obj);
+
+		if (! PyErr_Occurred()) {
+			len = snprintf(num, sizeof(num), "%lld", ival);
+			return AsonBuilder_put(b, num, len);
+		}
+
+		PyErr_Clear();
+		uval = PyLong_AsUnsignedLongLong(obj);
+
+		if (PyErr_Occurred())
+			return -1;
+
+		len = snprintf(num, sizeof(num), "%llu", uval);
+		return AsonBuilder_put(b, num, len);
+	}
+
+	if (PyFloat_Check(obj)) {
+		dval = PyFloat_AS_DOUBLE(obj);
+
+		if (! Py_IS_FINITE(dval))
+			return AsonBuilder_put_slot(b, ason_read("?F", dval));
+
+		str = PyOS_double_to_string(dval, 'r', 0, 0, NULL);
+
+		if (! str)
+			return -1;
+
+		ret = AsonBuilder_put(b, str, strlen(str));
+		PyMem_Free(str);
+		return ret;
+	}
+
+	if (PyObject_TypeCheck(obj, &ason_AsonType))
+		return AsonBuilder_put_slot(b, ason_copy_of((Ason *)obj));
+
+	if (PyDict_Check(obj))
+		return AsonBuilder_emit_dict(b, obj, 0);
+
+	if (! PyList_Check(obj))
+		return AsonBuilder_put_slot(b, pyobject_to_ason(obj));
+
+	if (Py_EnterRecursiveCall(" while converting a list to ASON"))
+		return -1;
+
+	ret = AsonBuilder_putc(b, '[');
+
+	/* Re-check the size each time; __ason__ hooks may mutate the list */
+	for (i = 0; ret == 0 && i < PyList_GET_SIZE(obj); i++) {
+		if (i > 0 && AsonBuilder_putc(b, ',') < 0) {
+			ret = -1;
+			break;
+		}
+
+		item = PyList_GET_ITEM(obj, i);
+		Py_INCREF(item);
+		ret = AsonBuilder_emit(b, item);
+		Py_DECREF(item);
+	}
+
+	if (ret == 0)
+		ret = AsonBuilder_putc(b, ']');
+
+	Py_LeaveRecursiveCall();
+	return ret;
+}
+
+/**
+ * One field of a dict being written out by a builder.
+ **/
+typedef struct {
+	const char *key;
+	Py_ssize_t len;
+	Py_ssize_t order;
+	PyObject *key_obj;
+	PyObject *value;
+} AsonBuilderField;
+
+/**
+ * Sort builder fields by key, keeping insertion order among equal keys.
+ **/
+static int
+AsonBuilderField_compare(const void *a, const void *b)
+{
+	const AsonBuilderField *x = a;
+	const AsonBuilderField *y = b;
+	Py_ssize_t len = x->len < y->len ? x->len : y->len;
+	int ret = memcmp(x->key, y->key, len);
+
+	if (ret)
+		return ret;
+
+	if (x->len != y->len)
+		return x->len < y->len ? -1 : 1;
+
+	return x->order < y->order ? -1 : 1;
+}
+
+/**
+ * Append the ASON text for a dict to a builder. All fields are gathered and
+ * sorted first so the object is written out once with each key appearing a
+ * single time. If `universal` is set the result is a universal object.
+ **/
+static int
+AsonBuilder_emit_dict(AsonBuilder *b, PyObject *obj, int universal)
+{
+	AsonBuilderField *fields;
+	PyObject *key;
+	PyObject *item;
+	Py_ssize_t count = 0;
+	Py_ssize_t size = PyDict_Size(obj);
+	Py_ssize_t pos;
+	Py_ssize_t i;
+	int first = 1;
+	int ret = -1;
+
+	fields = PyMem_Malloc((size ? size : 1) * sizeof(AsonBuilderField));
+
+	if (! fields) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	for (pos = 0; count < size && PyDict_Next(obj, &pos, &key, &item);) {
+		if (! PyStringType_Check(key)) {
+			PyErr_Format(PyExc_TypeError,
+				     "Cannot ASONify dict with non-string keys");
+			goto out;
+		}
+
+#ifdef PYTHON2
+		if (PyUnicode_Check(key))
+			key = PyUnicode_AsUTF8String(key);
+		else
+			Py_INCREF(key);
+
+		if (! key)
+			goto out;
+
+		fields[count].key = PyString_AS_STRING(key);
+		fields[count].len = PyString_GET_SIZE(key);
+#else
+		fields[count].key = PyUnicode_AsUTF8AndSize(key,
+							    &fields[count].len);
+
+		if (! fields[count].key)
+			goto out;
+
+		Py_INCREF(key);
+#endif
+		Py_INCREF(item);
+		fields[count].key_obj = key;
+		fields[count].value = item;
+		fields[count].order = count;
+		count++;
+	}
+
+	qsort(fields, count, sizeof(AsonBuilderField),
+	      AsonBuilderField_compare);
+
+	if (Py_EnterRecursiveCall(" while converting a dict to ASON"))
+		goto out;
+
+	ret = AsonBuilder_putc(b, '{');
+
+	for (i = 0; ret == 0 && i < count; i++) {
+		/* Of several equal keys the one inserted last wins */
+		if (i + 1 < count && fields[i].len == fields[i + 1].len &&
+		    ! memcmp(fields[i].key, fields[i + 1].key, fields[i].len))
+			continue;
+
+		if (! first && AsonBuilder_putc(b, ',') < 0)
+			ret = -1;
+		else if (AsonBuilder_put_string(b, fields[i].key,
+						fields[i].len) < 0)
+			ret = -1;
+		else if (AsonBuilder_putc(b, ':') < 0)
+			ret = -1;
+		else
+			ret = AsonBuilder_emit(b, fields[i].value);
+
+		first = 0;
+	}
+
+	if (ret == 0 && universal && ! first)
+		ret = AsonBuilder_put(b, ",*", 2);
+	else if (ret == 0 && universal)
+		ret = AsonBuilder_putc(b, '*');
+
+	if (ret == 0)
+		ret = AsonBuilder_putc(b, '}');
+
+	Py_LeaveRecursiveCall();
+
+out:
+	for (i = 0; i < count; i++) {
+		Py_DECREF(fields[i].key_obj);
+		Py_DECREF(fields[i].value);
+	}
+
+	PyMem_Free(fields);
+	return ret;
+}
+
+/**
+ * Read the text accumulated in a builder as a single ASON value. The builder
+ * is cleared whether or not this succeeds.
+ **/
+static ason_t *
+AsonBuilder_finish(AsonBuilder *b)
+{
+	ason_t *ret;
+
+	b->data[b->len] = '\0';
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = ason_ns_read(b->ns, b->data);
+	Py_END_ALLOW_THREADS
+
+	AsonBuilder_clear(b);
+
+	if (! ret)
+		PyErr_Format(PyExc_RuntimeError,
+			     "Could not build ASON value");
+
+	return ret;
+}
+
+/**
+ * Convert a python value to an ASON value.
+ **/
+static ason_t *
+pyobject_to_ason(PyObject *obj)
+{
+	int64_t ival;
+	uint64_t uval;
+	double dval;
+	char *str_key;
+	PyObject *hold;
+	AsonBuilder builder;
+	ason_t *ret;
+
+	if (PyStringType_Check(obj)) {
+		str_key = PyStringType_AsUTF8(obj, &hold);
+
+		if (! str_key)
+			return NULL;
+
+		ret = ason_read("?s", str_key);
+		Py_XDECREF(hold);
+		return ret;
+	}
+retry:
+	if (PyBool_Check(obj)) {
+		if (obj == Py_False)
+			return  ASON_FALSE;
+		else
+			return  ASON_TRUE;
+	}
+
+	if (obj == Py_None)
+		return ASON_NULL;
+
+	if (PyLong_Check(obj)) {
+		ival = PyLong_AsLongLong(obj);
+#ifdef PYTHON2
+parselong:
+#endif
+		if (! PyErr_Occurred())
+			return ason_read("?I", ival);
+
+		PyErr_Clear();
+		uval = PyLong_AsUnsignedLongLong(obj);
+
+		if (PyErr_Occurred())
+			return NULL;
+
+		return ason_read("?U", uval);
+	}
+
+	if (PyFloat_Check(obj)) {
+		dval = PyFloat_AsDouble(obj);
+
+		if (PyErr_Occurred())
+			return NULL;
+
+		return ason_read("?F", dval);
+	}
+
+#ifdef PYTHON2
+	if (PyInt_Check(obj)) {
+		ival = PyInt_AsLong(obj);
+		goto parselong;
+	}
+#endif
+
+	if (PyObject_TypeCheck(obj, &ason_AsonType))
+		return ason_copy_of((Ason *)obj);
+
+	if (PyList_Check(obj) || PyDict_Check(obj)) {
+		/* Rough guess of a few bytes of text per element */
+		if (AsonBuilder_init(&builder, PyObject_Size(obj) * 8) < 0)
+			return NULL;
+
+		if (AsonBuilder_emit(&builder, obj) < 0) {
+			AsonBuilder_clear(&builder);
+			return NULL;
+		}
+
+		return AsonBuilder_finish(&builder);
+	}
+
+	if (PyObject_HasAttrString(obj, "__ason__")) {
+		obj = PyObject_GetAttrString(obj, "__ason__");
+	} else if (PyObject_HasAttrString(obj, "__json__")) {
+		obj = PyObject_GetAttrString(obj, "__json__");
+	} else {
+		PyErr_Format(PyExc_TypeError, "Type '%s' is not ASONifiable",
+			     obj->ob_type->tp_name);
+		return NULL;
+	}
+
+	if (! obj)
+		return NULL;
+
+	obj = PyObject_CallFunctionObjArgs(obj, NULL);
+
+	if (! obj)
+		return NULL;
+
+	if (PyStringType_Check(obj)) {
+		str_key = PyStringType_AsUTF8(obj, &hold);
+
+		if (! str_key)
+			return NULL;
+
+		ret = ason_read(str_key);
+		Py_XDECREF(hold);
+		return ret;
+	}
+
+	goto retry;
+}
+
+/**
+ * Initialize an Ason object.
+ **/
+static int
+Ason_init(Ason *self, PyObject *args, PyObject *kwds)
+{
+	PyObject *obj;
+	static char *kwlist[] = {"value", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &obj))
+		return -1;
+
+	self->hash = -1;
+	Py_CLEAR(self->source);
+	Ason_clear_index(self);
+	self->value = pyobject_to_ason(obj);
+
+	if (! self->value)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Set up an AsonIter to walk a lazily parsed list or object straight from its
+ * text. Returns 0 if the value isn't one we can walk that way.
+ **/
+static int
+AsonIter_init_lazy(AsonIter *self, Ason *obj)
+{
+	const char *text;
+
+	if (! obj->source)
+		return 0;
+
+	switch (obj->kind) {
+	case ASON_TYPE_OBJECT:
+	case ASON_TYPE_UOBJECT:
+		self->in_object = 1;
+		break;
+	case ASON_TYPE_LIST:
+		self->in_object = 0;
+		break;
+	default:
+		return 0;
+	}
+
+	text = lazy_text(obj->source);
+
+	if (! text) {
+		PyErr_Clear();
+		return 0;
+	}
+
+	Py_INCREF(obj->source);
+	self->lazy = obj->source;
+	self->lazy_pos = obj->start + 1;
+	self->lazy_end = obj->start + obj->len - 1;
+	return 1;
+}
+
+/**
+ * Initialize an AsonIter object.
+ **/
+static int
+AsonIter_init(AsonIter *self, PyObject *args, PyObject *kwds)
+{
+	PyObject *obj;
+	ason_t *value;
+	static char *kwlist[] = {"value", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &obj))
+		return -1;
+
+	if (! PyObject_TypeCheck(obj, &ason_AsonType)) {
+		PyErr_Format(PyExc_TypeError,
+			     "Argument must be of type 'ason'");
+		return -1;
+	}
+
+	if (self->iter)
+		ason_iter_destroy(self->iter);
+
+	Py_CLEAR(self->lazy);
+	Py_CLEAR(self->result);
+	self->iter = NULL;
+	self->mode = ASON_ITER_ITEMS;
+	self->plain = 0;
+	self->entered = 0;
+	self->halt = 0;
+	self->enter_union = 0;
+
+	if (AsonIter_init_lazy(self, (Ason *)obj))
+		return 0;
+
+	value = Ason_value((Ason *)obj);
+
+	if (! value)
+		return -1;
+
+	self->iter = ason_iterate(value);
+
+	switch (ason_iter_type(self->iter)) {
+	case ASON_TYPE_OBJECT:
+	case ASON_TYPE_UOBJECT:
+		self->in_object = 1;
+		break;
+	default:
+		self->in_object = 0;
+		break;
+	};
+
+	return 0;
+}
+
+/**
+ * Make the (key, value) tuple for an object field, stealing both references.
+ * If the caller dropped the last tuple we handed out, it is filled in again
+ * instead of making a new one. Keys and Ason objects aren't tracked by the
+ * garbage collector, so reusing the tuple can't hide a cycle.
+ **/
+static PyObject *
+AsonIter_pair(AsonIter *self, PyObject *key, PyObject *value)
+{
+	PyObject *tuple = self->result;
+	PyObject *old_key;
+	PyObject *old_value;
+
+	if (tuple && Py_REFCNT(tuple) == 1) {
+		old_key = PyTuple_GET_ITEM(tuple, 0);
+		old_value = PyTuple_GET_ITEM(tuple, 1);
+		PyTuple_SET_ITEM(tuple, 0, key);
+		PyTuple_SET_ITEM(tuple, 1, value);
+		Py_DECREF(old_key);
+		Py_DECREF(old_value);
+		Py_INCREF(tuple);
+		return tuple;
+	}
+
+	tuple = PyTuple_New(2);
+
+	if (! tuple) {
+		Py_DECREF(key);
+		Py_DECREF(value);
+		return NULL;
+	}
+
+	PyTuple_SET_ITEM(tuple, 0, key);
+	PyTuple_SET_ITEM(tuple, 1, value);
+	Py_XDECREF(self->result);
+	self->result = tuple;
+	Py_INCREF(tuple);
+	return tuple;
+}
+
+/**
+ * Convert a null, boolean, number or string in unparsed ASON text straight to
+ * a Python value. Returns NULL with no exception set for anything else.
+ **/
+static PyObject *
+lazy_scalar(const char *text, size_t start, size_t end)
+{
+	char buf[64];
+	char *num_end;
+	PyObject *ret = NULL;
+	double dval;
+	size_t i = 0;
+
+	switch (lazy_classify(text, start, end)) {
+	case ASON_TYPE_NULL:
+		Py_RETURN_NONE;
+	case ASON_TYPE_TRUE:
+		Py_RETURN_TRUE;
+	case ASON_TYPE_FALSE:
+		Py_RETURN_FALSE;
+	case ASON_TYPE_STRING:
+		return lazy_string(text + start, end - start);
+	case ASON_TYPE_NUMERIC:
+		/* Longer numbers can wait to be parsed properly */
+		if (end - start >= sizeof(buf))
+			return NULL;
+
+		memcpy(buf, text + start, end - start);
+		buf[end - start] = '\0';
+
+		if (buf[0] == '-' || buf[0] == '+')
+			i++;
+
+		while (isdigit((unsigned char)buf[i]))
+			i++;
+
+		/* Integers are read exactly, like the parser does */
+		if (i == end - start && i) {
+			ret = PyLong_FromString(buf, &num_end, 10);
+
+			if (! ret || *num_end)
+				goto not_number;
+
+			return ret;
+		}
+
+		dval = PyOS_string_to_double(buf, &num_end, NULL);
+
+		if ((dval == -1.0 && PyErr_Occurred()) || *num_end)
+			goto not_number;
+
+		if (dval == floor(dval) && dval >= -9223372036854775808.0 &&
+		    dval < 9223372036854775808.0)
+			return PyLong_FromLongLong((long long)dval);
+
+		return PyFloat_FromDouble(dval);
+	default:
+		return NULL;
+	}
+
+not_number:
+	Py_XDECREF(ret);
+	PyErr_Clear();
+	return NULL;
+}
+
+/**
+ * Get a Python string for a quoted key in unparsed ASON text.
+ **/
+static PyObject *
+lazy_key(const char *text, size_t len)
+{
+	PyObject *ret;
+	size_t out_len;
+	char *buf;
+
+	if (! memchr(text + 1, '\\', len - 2))
+		return ason_key_string(text + 1, len - 2);
+
+	buf = lazy_unescape(text, len, &out_len);
+
+	if (! buf)
+		return NULL;
+
+	ret = ason_key_string(buf, out_len);
+	PyMem_Free(buf);
+	return ret;
+}
+
+/**
+ * Get the next value for an AsonIter walking unparsed text.
+ **/
+static PyObject *
+AsonIter_next_lazy(AsonIter *self)
+{
+	const char *text = lazy_text(self->lazy);
+	PyObject *key = NULL;
+	PyObject *val = NULL;
+	size_t start;
+	size_t end;
+	size_t colon;
+	size_t key_end;
+
+	if (! text)
+		return NULL;
+
+	for (;;) {
+		start = self->lazy_pos;
+
+		while (start < self->lazy_end &&
+		       isspace((unsigned char)text[start]))
+			start++;
+
+		if (start >= self->lazy_end)
+			return NULL;
+
+		end = lazy_scan(text, start, self->lazy_end, ",");
+		self->lazy_pos = end + 1;
+
+		/* The * of a universal object isn't a field */
+		if (! self->in_object || text[start] != '*')
+			break;
+	}
+
+	if (self->in_object) {
+		if (text[start] != '"') {
+			PyErr_Format(PyExc_TypeError,
+				     "Could not parse ASON expression");
+			return NULL;
+		}
+
+		colon = lazy_scan(text, start, end, ":");
+		key_end = colon;
+		lazy_trim(text, &start, &key_end);
+
+		if (colon >= end || key_end - start < 2 ||
+		    text[key_end - 1] != '"') {
+			PyErr_Format(PyExc_TypeError,
+				     "Could not parse ASON expression");
+			return NULL;
+		}
+
+		if (self->mode != ASON_ITER_VALUES) {
+			key = lazy_key(text + start, key_end - start);
+
+			if (! key || self->mode == ASON_ITER_KEYS)
+				return key;
+		}
+
+		start = colon + 1;
+	}
+
+	if (self->plain) {
+		lazy_trim(text, &start, &end);
+		val = lazy_scalar(text, start, end);
+	}
+
+	if (! val && ! PyErr_Occurred())
+		val = (PyObject *)Ason_lazy(self->lazy, start, end);
+
+	if (! val) {
+		Py_XDECREF(key);
+		return NULL;
+	}
+
+	if (! key)
+		return val;
+
+	return AsonIter_pair(self, key, val);
+}
+
+/**
+ * Get the next value for an AsonIter.
+ **/
+static PyObject *
+AsonIter_next(AsonIter *self)
+{
+	PyObject *key = NULL;
+	PyObject *val;
+	char *str_key;
+	int got;
+	ason_type_t type;
+
+	if (self->lazy)
+		return AsonIter_next_lazy(self);
+
+	type = ason_iter_type(self->iter);
+
+	if (! self->entered) {
+		self->entered = 1;
+
+		switch (type) {
+		case ASON_TYPE_OBJECT:
+		case ASON_TYPE_UOBJECT:
+		case ASON_TYPE_LIST:
+		case ASON_TYPE_UNION:
+			if ((type != ASON_TYPE_UNION) == (!self->enter_union)) {
+				got = ason_iter_enter(self->iter);
+				break;
+			}
+		/* fall-thru*/
+		default:
+			got = 1;
+			self->halt = 1;
+		};
+	} else {
+		/* Yes, this works in the non-collection case */
+		got = ason_iter_next(self->iter);
+	}
+
+	if (! got) /* No exception. Weird right? */
+		return NULL;
+
+	if (self->in_object && self->mode != ASON_ITER_VALUES) {
+		str_key = ason_iter_key(self->iter);
+
+		if (! str_key)
+			return PyErr_NoMemory();
+
+		key = ason_key_string(str_key, strlen(str_key));
+		free(str_key);
+
+		if (! key || self->mode == ASON_ITER_KEYS)
+			return key;
+	}
+
+	switch (self->plain ? ason_iter_type(self->iter) : ASON_TYPE_EMPTY) {
+	case ASON_TYPE_NULL:
+	case ASON_TYPE_TRUE:
+	case ASON_TYPE_FALSE:
+	case ASON_TYPE_NUMERIC:
+	case ASON_TYPE_STRING:
+		val = iter_to_python(self->iter, ASON_FALLBACK_ERROR);
+		break;
+	default:
+		val = (PyObject *)Ason_alloc();
+
+		if (val)
+			((Ason *)val)->value = ason_iter_value(self->iter);
+	}
+
+	if (! val) {
+		Py_XDECREF(key);
+		return NULL;
+	}
+
+	if (! key)
+		return val;
+
+	return AsonIter_pair(self, key, val);
+}
+
+/**
+ * Get an iterator for an Ason object.
+ **/
+static AsonIter *
+Ason_iterate(Ason *self)
+{
+	AsonIter *ret;
+	PyObject *args;
+	int got = 0;
+
+
+	args = Py_BuildValue("(O)", self);
+
+	if (! args)
+		return NULL;
+
+	ret = (AsonIter *)AsonFreeList_pop(&iter_free_list,
+					   &ason_AsonIterType);
+
+	if (ret) {
+		ret->iter = NULL;
+		ret->lazy = NULL;
+		ret->result = NULL;
+		got = AsonIter_init(ret, args, NULL);
+	}
+
+	Py_DECREF(args);
+
+	if (! got)
+		return ret;
+
+	Py_XDECREF(ret);
+
+	return NULL;
+}
+
+/**
+ * Get an iterator for an AsonIter object.
+ **/
+static AsonIter *
+AsonIter_iterate(AsonIter *self)
+{
+	Py_INCREF(self);
+	return self;
+}
+
+/**
+ * Get the ASON value of a Python object, borrowing it if the object is
+ * already an Ason and converting it otherwise. `owned` is set if the caller
+ * must destroy the result. Borrowed values are never copied, so work on them
+ * keeps the GIL: any Python thread can reach them.
+ **/
+static ason_t *
+ason_value_of(PyObject *obj, int *owned)
+{
+	if (PyObject_TypeCheck(obj, &ason_AsonType)) {
+		*owned = 0;
+		return Ason_value((Ason *)obj);
+	}
+
+	*owned = 1;
+	return pyobject_to_ason(obj);
+}
+
+/**
+ * Perform an Ason operation. If `idempotent` is set, the operation applied
+ * to a value and itself gives back the same value.
+ **/
+static PyObject *
+Ason_operate(PyObject *a, PyObject *b, const char *fmt, int idempotent)
+{
+	Ason *ret;
+	ason_t *left;
+	ason_t *right;
+	ason_t *value;
+	int own_left;
+	int own_right;
+
+	left = ason_value_of(a, &own_left);
+
+	if (! left)
+		return NULL;
+
+	right = ason_value_of(b, &own_right);
+
+	if (! right) {
+		if (own_left)
+			ason_destroy(left);
+		return NULL;
+	}
+
+	if (idempotent && left == right)
+		value = ason_copy(left);
+	else
+		value = ason_read(fmt, left, right);
+
+	if (own_left)
+		ason_destroy(left);
+	if (own_right)
+		ason_destroy(right);
+
+	if (! value) {
+		PyErr_Format(PyExc_TypeError,
+			     "Could not perform ASON operation");
+		return NULL;
+	}
+
+	ret = Ason_alloc();
+
+	if (! ret) {
+		ason_destroy(value);
+		return NULL;
+	}
+
+	ret->value = value;
+	return (PyObject *)ret;
+}
+
+/**
+ * Smallest number of values worth handing to a thread of its own in a bulk
+ * operation.
+ **/
+#define ASON_BULK_MIN_CHUNK 64
+
+/**
+ * Values gathered from a Python iterable for a bulk operation. `seq` keeps
+ * the Python objects alive while we borrow their ASON values.
+ **/
+typedef struct {
+	PyObject *seq;
+	ason_t **values;
+	char *owned;
+	Py_ssize_t len;
+} AsonBulk;
+
+/**
+ * Slice of a bulk operation run by one thread. If `schema` is set each value
+ * is checked against it and the answers go in `results`; otherwise the
+ * values are reduced with `fmt` into `result`, or unioned in one step if
+ * `fmt` is NULL.
+ **/
+typedef struct {
+	ason_t **values;
+	size_t len;
+	const char *fmt;
+	ason_t *result;
+	ason_t *schema;
+	char *results;
+} AsonBulkJob;
+
+/**
+ * Release the values gathered for a bulk operation.
+ **/
+static void
+AsonBulk_release(AsonBulk *bulk)
+{
+	Py_ssize_t i;
+
+	for (i = 0; bulk->owned && i < bulk->len; i++)
+		if (bulk->owned[i])
+			ason_destroy(bulk->values[i]);
+
+	PyMem_Free(bulk->values);
+	PyMem_Free(bulk->owned);
+	Py_CLEAR(bulk->seq);
+}
+
+/**
+ * Gather the ASON values of everything in an iterable, borrowing them from
+ * ason objects and converting anything else.
+ **/
+static int
+AsonBulk_get(AsonBulk *bulk, PyObject *iterable)
+{
+	int owned;
+	Py_ssize_t i;
+
+	bulk->values = NULL;
+	bulk->owned = NULL;
+	bulk->len = 0;
+	bulk->seq = PySequence_Fast(iterable, "Expected an iterable of values");
+
+	if (! bulk->seq)
+		return -1;
+
+	bulk->values = PyMem_Malloc((PySequence_Fast_GET_SIZE(bulk->seq) + 1) *
+				    sizeof(ason_t *));
+	bulk->owned = PyMem_Malloc(PySequence_Fast_GET_SIZE(bulk->seq) + 1);
+
+	if (! bulk->values || ! bulk->owned) {
+		PyErr_NoMemory();
+		AsonBulk_release(bulk);
+		return -1;
+	}
+
+	for (i = 0; i < PySequence_Fast_GET_SIZE(bulk->seq); i++) {
+		bulk->values[i] =
+			ason_value_of(PySequence_Fast_GET_ITEM(bulk->seq, i),
+				      &owned);
+
+		if (! bulk->values[i]) {
+			AsonBulk_release(bulk);
+			return -1;
+		}
+
+		bulk->owned[i] = owned;
+		bulk->len++;
+	}
+
+	return 0;
+}
+
+/**
+ * Union of any number of values, built with a single read so libason only
+ * normalizes the result once. The values are copied. Needs no Python API, so
+ * can run without the GIL on values no other thread can reach; returns NULL
+ * on failure.
+ **/
+static ason_t *
+ason_union_n(ason_t **values, size_t len)
+{
+	ason_ns_t *ns = ason_ns_create(ASON_NS_RAM, NULL);
+	ason_t *ret = NULL;
+	ason_t *copy;
+	char *text = malloc(len * 24 + 1);
+	char *name;
+	size_t pos = 0;
+	size_t i;
+
+	if (! ns || ! text)
+		goto out;
+
+	for (i = 0; i < len; i++) {
+		if (i)
+			text[pos++] = '|';
+
+		name = text + pos;
+		pos += sprintf(name, "v%zu", i);
+		copy = ason_copy(values[i]);
+
+		if (! copy || ason_ns_mkvar(ns, name) ||
+		    ason_ns_store(ns, name, copy)) {
+			ason_destroy(copy);
+			goto out;
+		}
+	}
+
+	/* sprintf leaves each name terminated, so the '|' goes over it */
+	text[pos] = '\0';
+	ret = len ? ason_ns_read(ns, text) : ason_copy(ASON_EMPTY);
+
+out:
+	free(text);
+
+	if (ns)
+		ason_ns_destroy(ns);
+
+	return ret;
+}
+
+/**
+ * Reduce some values with a binary operation. Values are combined in pairs,
+ * then the pairs in pairs and so on, so each is only copied into a
+ * logarithmic number of intermediate results. Like ason_union_n() it needs
+ * no Python API; returns NULL on failure.
+ **/
+static ason_t *
+ason_reduce(ason_t **values, size_t len, const char *fmt)
+{
+	ason_t **work = malloc(len * sizeof(ason_t *));
+	char *own = calloc(len, 1);
+	ason_t *ret = NULL;
+	ason_t *tmp;
+	size_t n = len;
+	size_t i;
+	int failed = 0;
+
+	if (! work || ! own)
+		goto out;
+
+	memcpy(work, values, len * sizeof(ason_t *));
+
+	while (n > 1 && ! failed) {
+		for (i = 0; i + 1 < n; i += 2) {
+			tmp = failed ? NULL :
+				ason_read(fmt, work[i], work[i + 1]);
+
+			if (own[i])
+				ason_destroy(work[i]);
+			if (own[i + 1])
+				ason_destroy(work[i + 1]);
+
+			failed |= ! tmp;
+			work[i / 2] = tmp;
+			own[i / 2] = tmp != NULL;
+		}
+
+		if (n % 2) {
+			work[n / 2] = work[n - 1];
+			own[n / 2] = own[n - 1];
+		}
+
+		n = (n + 1) / 2;
+	}
+
+	if (failed) {
+		for (i = 0; i < n; i++)
+			if (own[i])
+				ason_destroy(work[i]);
+
+		goto out;
+	}
+
+	ret = own[0] ? work[0] : ason_copy(work[0]);
+
+out:
+	free(work);
+	free(own);
+	return ret;
+}
+
+/**
+ * Run one slice of a bulk operation.
+ **/
+static void *
+AsonBulkJob_run(void *arg)
+{
+	AsonBulkJob *job = arg;
+	size_t i;
+
+	if (! job->schema) {
+		job->result = job->fmt ?
+			ason_reduce(job->values, job->len, job->fmt) :
+			ason_union_n(job->values, job->len);
+		return NULL;
+	}
+
+	for (i = 0; i < job->len; i++)
+		job->results[i] = ason_check_represented_in(job->values[i],
+							    job->schema);
+
+	return NULL;
+}
+
+/**
+ * Split a bulk operation over up to `threads` threads. Small inputs stay on
+ * the calling thread, which keeps the GIL. Returns the number of jobs used, or
+ * -1 on error. The jobs are copied from `proto`, with each given its share of
+ * the values (and of `results`).
+ *
+ * Nothing establishes that libason can work on one value from several threads
+ * at once, and the values are borrowed from ason objects any Python thread
+ * can reach. So when the work is split, it runs without the GIL on copies of
+ * the values, and each thread gets its own copy of the schema.
+ **/
+static int
+AsonBulk_run(AsonBulk *bulk, AsonBulkJob *proto, int threads,
+	     AsonBulkJob **jobs_out)
+{
+	AsonBulkJob *jobs;
+	ason_t **copies = NULL;
+	pthread_t *tids;
+	char *started;
+	size_t chunk;
+	size_t pos = 0;
+	Py_ssize_t n = 0;
+	int failed = 0;
+	int count;
+	int i;
+
+	count = threads < 1 ? 1 : threads;
+
+	if ((Py_ssize_t)count * ASON_BULK_MIN_CHUNK > bulk->len)
+		count = bulk->len / ASON_BULK_MIN_CHUNK;
+
+	if (count < 1)
+		count = 1;
+
+	jobs = PyMem_Malloc(count * sizeof(AsonBulkJob));
+	tids = PyMem_Malloc(count * sizeof(pthread_t));
+	started = PyMem_Malloc(count);
+
+	if (count > 1)
+		copies = PyMem_Malloc(bulk->len * sizeof(ason_t *));
+
+	if (! jobs || ! tids || ! started || (count > 1 && ! copies)) {
+		PyErr_NoMemory();
+		goto fail;
+	}
+
+	chunk = (bulk->len + count - 1) / count;
+
+	for (i = 0; i < count; i++) {
+		jobs[i] = *proto;
+		jobs[i].values = (copies ? copies : bulk->values) + pos;
+		jobs[i].len = (size_t)bulk->len - pos < chunk ?
+			(size_t)bulk->len - pos : chunk;
+
+		if (proto->results)
+			jobs[i].results = proto->results + pos;
+
+		/* Threads get their own copies of the schema, made below */
+		if (copies)
+			jobs[i].schema = NULL;
+
+		pos += jobs[i].len;
+	}
+
+	if (count == 1) {
+		AsonBulkJob_run(&jobs[0]);
+		goto out;
+	}
+
+	for (n = 0; n < bulk->len; n++)
+		if (! (copies[n] = ason_copy(bulk->values[n])))
+			goto fail_copy;
+
+	for (i = 0; proto->schema && i < count; i++)
+		if (! (jobs[i].schema = ason_copy(proto->schema)))
+			failed = 1;
+
+	if (failed)
+		goto fail_copy;
+
+	Py_BEGIN_ALLOW_THREADS
+	for (i = 1; i < count; i++)
+		started[i] = ! pthread_create(&tids[i], NULL, AsonBulkJob_run,
+					      &jobs[i]);
+
+	AsonBulkJob_run(&jobs[0]);
+
+	for (i = 1; i < count; i++) {
+		if (started[i])
+			pthread_join(tids[i], NULL);
+		else
+			AsonBulkJob_run(&jobs[i]);
+	}
+	Py_END_ALLOW_THREADS
+
+	for (i = 0; proto->schema && i < count; i++)
+		ason_destroy(jobs[i].schema);
+
+	while (n)
+		ason_destroy(copies[--n]);
+
+out:
+	PyMem_Free(copies);
+	PyMem_Free(tids);
+	PyMem_Free(started);
+	*jobs_out = jobs;
+	return count;
+
+fail_copy:
+	for (i = 0; proto->schema && i < count; i++)
+		ason_destroy(jobs[i].schema);
+
+	while (n)
+		ason_destroy(copies[--n]);
+
+	PyErr_NoMemory();
+fail:
+	PyMem_Free(copies);
+	PyMem_Free(jobs);
+	PyMem_Free(tids);
+	PyMem_Free(started);
+	return -1;
+}
+
+/**
+ * Reduce an iterable of values with a binary operation in C, or union them
+ * in one step if `fmt` is NULL. `empty` is the result for no values at all.
+ **/
+static PyObject *
+ason_reduce_all(PyObject *args, PyObject *kwargs, const char *fmt,
+		ason_t *empty)
+{
+	static char *kwlist[] = { "values", "threads", NULL };
+	PyObject *iterable;
+	AsonBulkJob proto = { NULL, 0, fmt, NULL, NULL, NULL };
+	AsonBulkJob *jobs;
+	AsonBulk bulk;
+	ason_t **partials;
+	ason_t *value = NULL;
+	Ason *ret;
+	int threads = 1;
+	int failed = 0;
+	int count;
+	int i;
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", kwlist,
+					  &iterable, &threads))
+		return NULL;
+
+	if (AsonBulk_get(&bulk, iterable) < 0)
+		return NULL;
+
+	if (! bulk.len) {
+		AsonBulk_release(&bulk);
+		value = ason_copy(empty);
+		goto done;
+	}
+
+	count = AsonBulk_run(&bulk, &proto, threads, &jobs);
+
+	if (count < 0) {
+		AsonBulk_release(&bulk);
+		return NULL;
+	}
+
+	partials = PyMem_Malloc(count * sizeof(ason_t *));
+
+	if (! partials) {
+		for (i = 0; i < count; i++)
+			ason_destroy(jobs[i].result);
+
+		PyMem_Free(jobs);
+		AsonBulk_release(&bulk);
+		return PyErr_NoMemory();
+	}
+
+	/* Each thread left a partial result; combine them */
+	Py_BEGIN_ALLOW_THREADS
+	for (i = 0; i < count; i++) {
+		partials[i] = jobs[i].result;
+		failed |= ! partials[i];
+	}
+
+	if (count == 1)
+		value = partials[0];
+	else if (! failed)
+		value = fmt ? ason_reduce(partials, count, fmt) :
+			ason_union_n(partials, count);
+
+	for (i = 0; count > 1 && i < count; i++)
+		ason_destroy(partials[i]);
+	Py_END_ALLOW_THREADS
+
+	PyMem_Free(partials);
+	PyMem_Free(jobs);
+	AsonBulk_release(&bulk);
+
+done:
+	if (! value) {
+		PyErr_Format(PyExc_TypeError,
+			     "Could not perform ASON operation");
+		return NULL;
+	}
+
+	ret = Ason_alloc();
+
+	if (! ret) {
+		ason_destroy(value);
+		return NULL;
+	}
+
+	ret->value = value;
+	return (PyObject *)ret;
+}
+
+/**
+ * Union of every value in an iterable.
+ **/
+static PyObject *
+ason_union_all(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	return ason_reduce_all(args, kwargs, NULL, ASON_EMPTY);
+}
+
+/**
+ * Union of all the arguments, built in one step.
+ **/
+static PyObject *
+ason_union_values(PyObject *self, PyObject *args)
+{
+	AsonBulk bulk;
+	ason_t *value;
+	Ason *ret;
+
+	if (AsonBulk_get(&bulk, args) < 0)
+		return NULL;
+
+	value = ason_union_n(bulk.values, bulk.len);
+
+	AsonBulk_release(&bulk);
+
+	if (! value) {
+		PyErr_Format(PyExc_TypeError,
+			     "Could not perform ASON operation");
+		return NULL;
+	}
+
+	ret = Ason_alloc();
+
+	if (! ret) {
+		ason_destroy(value);
+		return NULL;
+	}
+
+	ret->value = value;
+	return (PyObject *)ret;
+}
+
+/**
+ * Intersection of every value in an iterable.
+ **/
+static PyObject *
+ason_intersect_all(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	return ason_reduce_all(args, kwargs, "? & ?", ASON_UNIVERSE);
+}
+
+/**
+ * Pick out the values in an iterable which are represented in a schema.
+ **/
+static PyObject *
+ason_filter_represented(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = { "values", "schema", "threads", NULL };
+	PyObject *iterable;
+	PyObject *schema_obj;
+	PyObject *ret = NULL;
+	AsonBulkJob proto = { NULL, 0, NULL, NULL, NULL, NULL };
+	AsonBulkJob *jobs;
+	AsonBulk bulk;
+	Py_ssize_t i;
+	int own_schema;
+	int threads = 1;
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "OO|i", kwlist,
+					  &iterable, &schema_obj, &threads))
+		return NULL;
+
+	proto.schema = ason_value_of(schema_obj, &own_schema);
+
+	if (! proto.schema)
+		return NULL;
+
+	if (AsonBulk_get(&bulk, iterable) < 0)
+		goto out_schema;
+
+	proto.results = PyMem_Malloc(bulk.len + 1);
+
+	if (! proto.results) {
+		PyErr_NoMemory();
+		goto out_bulk;
+	}
+
+	if (AsonBulk_run(&bulk, &proto, threads, &jobs) < 0)
+		goto out_results;
+
+	PyMem_Free(jobs);
+	ret = PyList_New(0);
+
+	for (i = 0; ret && i < bulk.len; i++) {
+		if (proto.results[i] &&
+		    PyList_Append(ret, PySequence_Fast_GET_ITEM(bulk.seq, i)))
+			Py_CLEAR(ret);
+	}
+
+out_results:
+	PyMem_Free(proto.results);
+out_bulk:
+	AsonBulk_release(&bulk);
+out_schema:
+	if (own_schema)
+		ason_destroy(proto.schema);
+
+	return ret;
+}
+
+/**
+ * Tags for values in the binary encoding.
+ **/
+enum {
+	ASON_BIN_EMPTY,
+	ASON_BIN_NULL,
+	ASON_BIN_TRUE,
+	ASON_BIN_FALSE,
+	ASON_BIN_INT,
+	ASON_BIN_FLOAT,
+	ASON_BIN_STRING,
+	ASON_BIN_UNION,
+	ASON_BIN_LIST,
+	ASON_BIN_OBJECT,
+	ASON_BIN_UOBJECT,
+	ASON_BIN_COMP,
+	ASON_BIN_UNIVERSE,
+	ASON_BIN_WILD,
+	ASON_BIN_END,
+};
+
+/**
+ * Header at the start of binary encoded ASON.
+ **/
+#define ASON_BIN_MAGIC "ASB\001"
+
+/**
+ * State for writing the binary encoding. Object keys are written in full the
+ * first time they appear and by number after that; `keys` maps each key
+ * written so far to its number.
+ **/
+typedef struct {
+	AsonBuilder out;
+	PyObject *keys;
+} AsonBinWriter;
+
+/**
+ * State for reading the binary encoding. Keys point into the input.
+ **/
+typedef struct {
+	const unsigned char *pos;
+	const unsigned char *end;
+	const unsigned char **keys;
+	size_t *key_lens;
+	size_t n_keys;
+	size_t size_keys;
+} AsonBinReader;
+
+/**
+ * Append an unsigned LEB128 number to a builder.
+ **/
+static int
+ason_bin_put_varint(AsonBuilder *b, uint64_t value)
+{
+	char buf[10];
+	size_t len = 0;
+
+	do {
+		buf[len] = value & 0x7f;
+		value >>= 7;
+
+		if (value)
+			buf[len] |= 0x80;
+
+		len++;
+	} while (value);
+
+	return AsonBuilder_put(b, buf, len);
+}
+
+static int ason_bin_write(AsonBinWriter *w, ason_iter_t *iter);
+
+/**
+ * Write an ASON value in binary.
+ **/
+static int
+ason_bin_write_value(AsonBinWriter *w, ason_t *value)
+{
+	ason_iter_t *iter = ason_iterate(value);
+	int ret;
+
+	if (! iter) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	ret = ason_bin_write(w, iter);
+	ason_iter_destroy(iter);
+	return ret;
+}
+
+/**
+ * Write an object key in binary: 1 and then the key the first time we see
+ * it, and its number plus 2 after that. 0 ends an object.
+ **/
+static int
+ason_bin_write_key(AsonBinWriter *w, const char *key)
+{
+	size_t len = strlen(key);
+	PyObject *str = ason_key_string(key, len);
+	PyObject *index;
+	int ret;
+
+	if (! str)
+		return -1;
+
+	index = PyDict_GetItemWithError(w->keys, str);
+
+	if (! index && PyErr_Occurred()) {
+		Py_DECREF(str);
+		return -1;
+	}
+
+	if (index) {
+		Py_DECREF(str);
+		return ason_bin_put_varint(&w->out,
+					   PyLong_AsSsize_t(index) + 2);
+	}
+
+	index = PyLong_FromSsize_t(PyDict_Size(w->keys));
+	ret = index ? PyDict_SetItem(w->keys, str, index) : -1;
+	Py_XDECREF(index);
+	Py_DECREF(str);
+
+	if (ret < 0 || ason_bin_put_varint(&w->out, 1) < 0 ||
+	    ason_bin_put_varint(&w->out, len) < 0)
+		return -1;
+
+	return AsonBuilder_put(&w->out, key, len);
+}
+
+/**
+ * Write the value under an iterator in binary.
+ **/
+static int
+ason_bin_write(AsonBinWriter *w, ason_iter_t *iter)
+{
+	static const char tags[] = {
+		[ASON_TYPE_EMPTY] = ASON_BIN_EMPTY,
+		[ASON_TYPE_NULL] = ASON_BIN_NULL,
+		[ASON_TYPE_TRUE] = ASON_BIN_TRUE,
+		[ASON_TYPE_FALSE] = ASON_BIN_FALSE,
+		[ASON_TYPE_STRING] = ASON_BIN_STRING,
+		[ASON_TYPE_UNION] = ASON_BIN_UNION,
+		[ASON_TYPE_LIST] = ASON_BIN_LIST,
+		[ASON_TYPE_OBJECT] = ASON_BIN_OBJECT,
+		[ASON_TYPE_UOBJECT] = ASON_BIN_UOBJECT,
+		[ASON_TYPE_COMP] = ASON_BIN_COMP,
+		[ASON_TYPE_UNIVERSE] = ASON_BIN_UNIVERSE,
+		[ASON_TYPE_WILD] = ASON_BIN_WILD,
+	};
+	ason_type_t type = ason_iter_type(iter);
+	unsigned char bytes[8];
+	ason_t *value;
+	ason_t *inner;
+	long long lval;
+	uint64_t bits;
+	double dval;
+	char *str;
+	int ret = 0;
+	int i;
+
+	if (type == ASON_TYPE_NUMERIC) {
+		dval = ason_iter_double(iter);
+
+		/* -0.0 is whole but would lose its sign as an integer */
+		if (dval == floor(dval) && dval >= -9223372036854775808.0 &&
+		    dval < 9223372036854775808.0 &&
+		    (dval != 0 || ! signbit(dval))) {
+			lval = ason_iter_long(iter);
+
+			if (AsonBuilder_putc(&w->out, ASON_BIN_INT) < 0)
+				return -1;
+
+			/* Zig-zag, so small negative numbers stay short */
+			return ason_bin_put_varint(&w->out,
+						   ((uint64_t)lval << 1) ^
+						   (uint64_t)(lval >> 63));
+		}
+
+		memcpy(&bits, &dval, sizeof(bits));
+
+		for (i = 0; i < 8; i++)
+			bytes[i] = bits >> (8 * i);
+
+		if (AsonBuilder_putc(&w->out, ASON_BIN_FLOAT) < 0)
+			return -1;
+
+		return AsonBuilder_put(&w->out, (char *)bytes, 8);
+	}
+
+	if (AsonBuilder_putc(&w->out, tags[type]) < 0)
+		return -1;
+
+	switch (type) {
+	case ASON_TYPE_STRING:
+		str = ason_iter_string(iter);
+
+		if (! str) {
+			PyErr_NoMemory();
+			return -1;
+		}
+
+		ret = ason_bin_put_varint(&w->out, strlen(str));
+
+		if (! ret)
+			ret = AsonBuilder_put(&w->out, str, strlen(str));
+
+		free(str);
+		return ret;
+	case ASON_TYPE_COMP:
+		/* The complement of a complement is what it complements */
+		value = ason_iter_value(iter);
+		inner = ason_read("!?", value);
+		ason_destroy(value);
+
+		if (! inner) {
+			PyErr_Format(PyExc_TypeError,
+				     "Could not perform ASON operation");
+			return -1;
+		}
+
+		ret = ason_bin_write_value(w, inner);
+		ason_destroy(inner);
+		return ret;
+	case ASON_TYPE_UNION:
+	case ASON_TYPE_LIST:
+	case ASON_TYPE_OBJECT:
+	case ASON_TYPE_UOBJECT:
+		break;
+	default:
+		return 0;
+	}
+
+	if (Py_EnterRecursiveCall(" while encoding ASON"))
+		return -1;
+
+	if (ason_iter_enter(iter)) {
+		do {
+			if (type == ASON_TYPE_OBJECT ||
+			    type == ASON_TYPE_UOBJECT) {
+				str = ason_iter_key(iter);
+				ret = str ? ason_bin_write_key(w, str) : -1;
+				free(str);
+
+				if (ret < 0)
+					break;
+			}
+
+			ret = ason_bin_write(w, iter);
+		} while (ret == 0 && ason_iter_next(iter));
+
+		ason_iter_exit(iter);
+	}
+
+	Py_LeaveRecursiveCall();
+
+	if (ret < 0)
+		return -1;
+
+	if (type == ASON_TYPE_OBJECT || type == ASON_TYPE_UOBJECT)
+		return ason_bin_put_varint(&w->out, 0);
+
+	return AsonBuilder_putc(&w->out, ASON_BIN_END);
+}
+
+/**
+ * Complain about bad binary input.
+ **/
+static int
+ason_bin_bad(void)
+{
+	PyErr_Format(PyExc_ValueError, "Corrupt binary ASON data");
+	return -1;
+}
+
+/**
+ * Read an unsigned LEB128 number.
+ **/
+static int
+ason_bin_get_varint(AsonBinReader *r, uint64_t *out)
+{
+	unsigned shift = 0;
+
+	*out = 0;
+
+	do {
+		if (r->pos == r->end || shift > 63)
+			return ason_bin_bad();
+
+		*out |= (uint64_t)(*r->pos & 0x7f) << shift;
+		shift += 7;
+	} while (*r->pos++ & 0x80);
+
+	return 0;
+}
+
+/**
+ * Read an object key, or get an empty key for the end of an object.
+ **/
+static int
+ason_bin_get_key(AsonBinReader *r, const unsigned char **key, size_t *len)
+{
+	const unsigned char **keys;
+	size_t *key_lens;
+	uint64_t index;
+	uint64_t key_len;
+
+	*key = NULL;
+
+	if (ason_bin_get_varint(r, &index) < 0)
+		return -1;
+
+	if (! index)
+		return 0;
+
+	if (index > 1) {
+		if (index - 2 >= r->n_keys)
+			return ason_bin_bad();
+
+		*key = r->keys[index - 2];
+		*len = r->key_lens[index - 2];
+		return 0;
+	}
+
+	if (ason_bin_get_varint(r, &key_len) < 0)
+		return -1;
+
+	if (key_len > (uint64_t)(r->end - r->pos))
+		return ason_bin_bad();
+
+	if (r->n_keys == r->size_keys) {
+		r->size_keys = r->size_keys ? r->size_keys * 2 : 16;
+		keys = PyMem_Realloc(r->keys, r->size_keys * sizeof(*keys));
+
+		if (keys)
+			r->keys = keys;
+
+		key_lens = PyMem_Realloc(r->key_lens,
+					 r->size_keys * sizeof(*key_lens));
+
+		if (key_lens)
+			r->key_lens = key_lens;
+
+		if (! keys || ! key_lens) {
+			PyErr_NoMemory();
+			return -1;
+		}
+	}
+
+	*key = r->pos;
+	*len = key_len;
+	r->keys[r->n_keys] = r->pos;
+	r->key_lens[r->n_keys++] = key_len;
+	r->pos += key_len;
+	return 0;
+}
+
+/**
+ * Read one binary encoded value into a builder as ASON text. Strings and
+ * numbers go in as literals, containers as their brackets around their
+ * members, unions as their alternatives joined with | in parentheses and
+ * complements as ! before their parenthesized operand. The few values with
+ * no literal (empty, wild, universe, non-finite floats and -0.0) are parked
+ * in the builder's namespace, so the whole value is read by libason at once.
+ **/
+static int
+ason_bin_emit(AsonBinReader *r, AsonBuilder *b)
+{
+	const unsigned char *key;
+	size_t key_len;
+	uint64_t num;
+	uint64_t bits = 0;
+	char buf[32];
+	double dval;
+	char *str;
+	int first = 1;
+	int ret = 0;
+	int tag;
+	int i;
+
+	if (r->pos == r->end)
+		return ason_bin_bad();
+
+	tag = *r->pos++;
+
+	switch (tag) {
+	case ASON_BIN_EMPTY:
+		return AsonBuilder_put_slot(b, ason_copy(ASON_EMPTY));
+	case ASON_BIN_UNIVERSE:
+		return AsonBuilder_put_slot(b, ason_copy(ASON_UNIVERSE));
+	case ASON_BIN_WILD:
+		return AsonBuilder_put_slot(b, ason_copy(ASON_WILD));
+	case ASON_BIN_NULL:
+		return AsonBuilder_put(b, "null", 4);
+	case ASON_BIN_TRUE:
+		return AsonBuilder_put(b, "true", 4);
+	case ASON_BIN_FALSE:
+		return AsonBuilder_put(b, "false", 5);
+	case ASON_BIN_INT:
+		if (ason_bin_get_varint(r, &num) < 0)
+			return -1;
+
+		num = (num >> 1) ^ (~(num & 1) + 1);
+		return AsonBuilder_put(b, buf, snprintf(buf, sizeof(buf),
+							"%lld",
+							(long long)num));
+	case ASON_BIN_FLOAT:
+		if (r->end - r->pos < 8)
+			return ason_bin_bad();
+
+		for (i = 0; i < 8; i++)
+			bits |= (uint64_t)*r->pos++ << (8 * i);
+
+		memcpy(&dval, &bits, sizeof(dval));
+
+		if (! Py_IS_FINITE(dval) || (dval == 0 && signbit(dval)))
+			return AsonBuilder_put_slot(b, ason_read("?F", dval));
+
+		str = PyOS_double_to_string(dval, 'r', 0, 0, NULL);
+
+		if (! str)
+			return -1;
+
+		ret = AsonBuilder_put(b, str, strlen(str));
+		PyMem_Free(str);
+		return ret;
+	case ASON_BIN_STRING:
+		if (ason_bin_get_varint(r, &num) < 0)
+			return -1;
+
+		if (num > (uint64_t)(r->end - r->pos))
+			return ason_bin_bad();
+
+		r->pos += num;
+		return AsonBuilder_put_string(b, (const char *)r->pos - num,
+					      num);
+	case ASON_BIN_COMP:
+		if (AsonBuilder_put(b, "!(", 2) < 0)
+			return -1;
+
+		if (Py_EnterRecursiveCall(" while decoding ASON"))
+			return -1;
+
+		ret = ason_bin_emit(r, b);
+		Py_LeaveRecursiveCall();
+
+		return ret ? ret : AsonBuilder_putc(b, ')');
+	case ASON_BIN_UNION:
+		if (r->pos < r->end && *r->pos == ASON_BIN_END) {
+			r->pos++;
+			return AsonBuilder_put_slot(b, ason_copy(ASON_EMPTY));
+		}
+
+		if (AsonBuilder_putc(b, '(') < 0)
+			return -1;
+
+		if (Py_EnterRecursiveCall(" while decoding ASON"))
+			return -1;
+
+		while (ret == 0 && r->pos < r->end &&
+		       *r->pos != ASON_BIN_END) {
+			if (! first && AsonBuilder_putc(b, '|') < 0)
+				ret = -1;
+			else
+				ret = ason_bin_emit(r, b);
+
+			first = 0;
+		}
+
+		Py_LeaveRecursiveCall();
+
+		if (ret)
+			return ret;
+
+		if (r->pos == r->end)
+			return ason_bin_bad();
+
+		r->pos++;
+		return AsonBuilder_putc(b, ')');
+	case ASON_BIN_LIST:
+	case ASON_BIN_OBJECT:
+	case ASON_BIN_UOBJECT:
+		break;
+	default:
+		return ason_bin_bad();
+	}
+
+	if (Py_EnterRecursiveCall(" while decoding ASON"))
+		return -1;
+
+	ret = AsonBuilder_putc(b, tag == ASON_BIN_LIST ? '[' : '{');
+
+	while (ret == 0) {
+		if (tag == ASON_BIN_LIST) {
+			if (r->pos == r->end) {
+				ret = ason_bin_bad();
+				break;
+			}
+
+			if (*r->pos == ASON_BIN_END) {
+				r->pos++;
+				break;
+			}
+		} else {
+			ret = ason_bin_get_key(r, &key, &key_len);
+
+			if (ret < 0 || ! key)
+				break;
+		}
+
+		if (! first && AsonBuilder_putc(b, ',') < 0)
+			ret = -1;
+		else if (tag != ASON_BIN_LIST &&
+			 (AsonBuilder_put_string(b, (const char *)key,
+						 key_len) < 0 ||
+			  AsonBuilder_putc(b, ':') < 0))
+			ret = -1;
+		else
+			ret = ason_bin_emit(r, b);
+
+		first = 0;
+	}
+
+	if (ret == 0 && tag == ASON_BIN_UOBJECT)
+		ret = first ? AsonBuilder_putc(b, '*') :
+			AsonBuilder_put(b, ",*", 2);
+
+	if (ret == 0)
+		ret = AsonBuilder_putc(b, tag == ASON_BIN_LIST ? ']' : '}');
+
+	Py_LeaveRecursiveCall();
+	return ret;
+}
+
+/**
+ * Read one binary encoded value, by writing it out as ASON text and reading
+ * that with libason.
+ **/
+static ason_t *
+ason_bin_read_value(AsonBinReader *r)
+{
+	AsonBuilder builder;
+
+	if (AsonBuilder_init(&builder, 0) < 0)
+		return NULL;
+
+	if (ason_bin_emit(r, &builder) < 0) {
+		AsonBuilder_clear(&builder);
+		return NULL;
+	}
+
+	return AsonBuilder_finish(&builder);
+}
+
+/**
+ * Encode an ASON value in the compact binary format as bytes.
+ **/
+static PyObject *
+ason_bin_encode(ason_t *value)
+{
+	AsonBinWriter writer;
+	PyObject *ret = NULL;
+
+	writer.keys = PyDict_New();
+
+	if (! writer.keys)
+		return NULL;
+
+	if (AsonBuilder_init(&writer.out, 0) < 0) {
+		Py_DECREF(writer.keys);
+		return NULL;
+	}
+
+	if (AsonBuilder_put(&writer.out, ASON_BIN_MAGIC, 4) == 0 &&
+	    ason_bin_write_value(&writer, value) == 0)
+		ret = PyBytes_FromStringAndSize(writer.out.data,
+						writer.out.len);
+
+	AsonBuilder_clear(&writer.out);
+	Py_DECREF(writer.keys);
+	return ret;
+}
+
+/**
+ * Encode a value in the compact binary format.
+ **/
+static PyObject *
+ason_dumpb(PyObject *self, PyObject *args)
+{
+	PyObject *obj;
+	PyObject *ret;
+	ason_t *value;
+	int owned;
+
+	if (! PyArg_ParseTuple(args, "O", &obj))
+		return NULL;
+
+	value = ason_value_of(obj, &owned);
+
+	if (! value)
+		return NULL;
+
+	ret = ason_bin_encode(value);
+
+	if (owned)
+		ason_destroy(value);
+
+	return ret;
+}
+
+/**
+ * Decode a value from the compact binary format.
+ **/
+static PyObject *
+ason_loadb(PyObject *self, PyObject *args)
+{
+	AsonBinReader reader;
+	Py_buffer view;
+	PyObject *obj;
+	ason_t *value = NULL;
+	Ason *ret;
+
+	if (! PyArg_ParseTuple(args, "O", &obj))
+		return NULL;
+
+	if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) < 0)
+		return NULL;
+
+	reader.pos = view.buf;
+	reader.end = reader.pos + view.len;
+	reader.keys = NULL;
+	reader.key_lens = NULL;
+	reader.n_keys = 0;
+	reader.size_keys = 0;
+
+	if (view.len < 4 || memcmp(view.buf, ASON_BIN_MAGIC, 4)) {
+		PyErr_Format(PyExc_ValueError, "Not binary ASON data");
+		goto out;
+	}
+
+	reader.pos += 4;
+	value = ason_bin_read_value(&reader);
+
+	if (value && reader.pos != reader.end) {
+		ason_destroy(value);
+		value = NULL;
+		ason_bin_bad();
+	}
+
+out:
+	PyMem_Free(reader.keys);
+	PyMem_Free(reader.key_lens);
+	PyBuffer_Release(&view);
+
+	if (! value)
+		return NULL;
+
+	ret = Ason_alloc();
+
+	if (! ret) {
+		ason_destroy(value);
+		return NULL;
+	}
+
+	ret->value = value;
+	return (PyObject *)ret;
+}
+
+/**
+ * Module function that decodes pickled values. Set when the module loads.
+ **/
+static PyObject *ason_loadb_func = NULL;
+
+/**
+ * Pickle an ASON value as its binary encoding, to be read back with
+ * ason.loadb, which writes it out as text for libason to read. From protocol
+ * 5 the encoding is handed over as a PickleBuffer so it can travel out of
+ * band.
+ **/
+static PyObject *
+Ason_reduce_ex(Ason *self, PyObject *args)
+{
+	PyObject *data;
+	ason_t *value;
+	int protocol = 0;
+
+	if (! PyArg_ParseTuple(args, "|i", &protocol))
+		return NULL;
+
+	value = Ason_value(self);
+
+	if (! value)
+		return NULL;
+
+	data = ason_bin_encode(value);
+
+#if PY_VERSION_HEX >= 0x03080000
+	if (data && protocol >= 5) {
+		PyObject *buf = PyPickleBuffer_FromObject(data);
+
+		Py_DECREF(data);
+		data = buf;
+	}
+#endif
+
+	if (! data)
+		return NULL;
+
+	return Py_BuildValue("O(N)", ason_loadb_func, data);
+}
+
+/**
+ * ASON values are immutable, so copies can be the value itself.
+ **/
+static PyObject *
+Ason_copy(Ason *self, PyObject *args)
+{
+	Py_INCREF(self);
+	return (PyObject *)self;
+}
+
+/**
+ * Make a universal object
+ **/
+static Ason *
+ason_uobject(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *dict;
+	PyObject *tmp = NULL;
+	AsonBuilder builder;
+	ason_t *ret;
+	Ason *ret_object;
+
+	if (! PyArg_ParseTuple(args, "|O", &tmp))
+		return NULL;
+
+	dict = PyDict_New();
+
+	if (tmp && !PyDict_Check(tmp)) {
+		 if (PyDict_MergeFromSeq2(dict, tmp, 1) < 0)
+			return NULL;
+	} else if (tmp && PyDict_Update(dict, tmp) < 0) {
+		return NULL;
+	}
+
+	if (kwargs && PyDict_Update(dict, kwargs) < 0)
+		return NULL;
+
+	if (AsonBuilder_init(&builder, PyDict_Size(dict) * 16) < 0) {
+		Py_DECREF(dict);
+		return NULL;
+	}
+
+	if (AsonBuilder_emit_dict(&builder, dict, 1) < 0) {
+		AsonBuilder_clear(&builder);
+		Py_DECREF(dict);
+		return NULL;
+	}
+
+	Py_DECREF(dict);
+	ret = AsonBuilder_finish(&builder);
+
+	if (! ret)
+		return NULL;
+
+	ret_object = Ason_alloc();
+
+	if (! ret_object) {
+		ason_destroy(ret);
+		return NULL;
+	}
+
+	ret_object->value = ret;
+
+	return ret_object;
+}
+
+/**
+ * NUL-terminated text to be parsed, borrowed from a Python object where that
+ * is possible and copied otherwise.
+ **/
+typedef struct {
+	char *text;
+	PyObject *hold;
+	Py_buffer view;
+	int have_view;
+	char *copy;
+} AsonText;
+
+/**
+ * Release whatever an AsonText is holding.
+ **/
+static void
+AsonText_release(AsonText *t)
+{
+	Py_CLEAR(t->hold);
+	PyMem_Free(t->copy);
+	t->copy = NULL;
+	t->text = NULL;
+
+	if (t->have_view)
+		PyBuffer_Release(&t->view);
+
+	t->have_view = 0;
+}
+
+/**
+ * Get text to parse from a string or any object supporting the buffer
+ * protocol.
+ **/
+static int
+AsonText_get(AsonText *t, PyObject *obj)
+{
+	Py_ssize_t len;
+
+	t->text = NULL;
+	t->hold = NULL;
+	t->have_view = 0;
+	t->copy = NULL;
+
+	if (PyStringType_Check(obj) && ! PyBytes_Check(obj)) {
+		t->text = PyStringType_AsUTF8AndSize(obj, &t->hold, &len);
+
+		if (! t->text)
+			return -1;
+
+		/* libason would stop at the NUL and ignore the rest */
+		if (strlen(t->text) != (size_t)len) {
+			PyErr_Format(PyExc_ValueError,
+				     "ASON text contains a NUL character");
+			AsonText_release(t);
+			return -1;
+		}
+
+		return 0;
+	}
+
+	if (PyObject_GetBuffer(obj, &t->view, PyBUF_SIMPLE) < 0) {
+		PyErr_Format(PyExc_TypeError, "ASON text must be a string or "
+			     "bytes-like object");
+		return -1;
+	}
+
+	t->have_view = 1;
+
+	if (memchr(t->view.buf, '\0', t->view.len)) {
+		PyErr_Format(PyExc_ValueError,
+			     "ASON text contains a NUL byte");
+		AsonText_release(t);
+		return -1;
+	}
+
+	/* bytes and bytearray always keep a NUL just past their contents */
+	if (PyBytes_Check(obj) || PyByteArray_Check(obj)) {
+		t->text = t->view.buf;
+		return 0;
+	}
+
+	t->copy = PyMem_Malloc(t->view.len + 1);
+
+	if (! t->copy) {
+		PyErr_NoMemory();
+		AsonText_release(t);
+		return -1;
+	}
+
+	memcpy(t->copy, t->view.buf, t->view.len);
+	t->copy[t->view.len] = '\0';
+	t->text = t->copy;
+	return 0;
+}
+
+/**
+ * Make a lazily parsed Ason object for the whole of some text. The object
+ * keeps the source alive rather than copying it where it can.
+ **/
+static PyObject *
+ason_parse_lazy(PyObject *source, AsonText *text)
+{
+	PyObject *hold;
+	Ason *ret;
+
+#ifdef PYTHON2
+	if (PyBytes_Check(source)) {
+#else
+	if (PyBytes_Check(source) || PyUnicode_Check(source)) {
+#endif
+		Py_INCREF(source);
+		hold = source;
+	} else {
+		hold = PyBytes_FromString(text->text);
+	}
+
+	AsonText_release(text);
+
+	if (! hold)
+		return NULL;
+
+	ret = Ason_lazy(hold, 0, strlen(lazy_text(hold)));
+	Py_DECREF(hold);
+	return (PyObject *)ret;
+}
+
+/**
+ * State for reading JSON text into a builder.
+ **/
+typedef struct {
+	const char *text;
+	const char *pos;
+	const char *end;
+	AsonBuilder *out;
+} AsonJson;
+
+/**
+ * Complain about invalid JSON at the current position.
+ **/
+static int
+AsonJson_fail(AsonJson *j)
+{
+	PyErr_Format(PyExc_ValueError, "Invalid JSON at offset %zd",
+		     (Py_ssize_t)(j->pos - j->text));
+	return -1;
+}
+
+/**
+ * Skip JSON whitespace.
+ **/
+static void
+AsonJson_skip(AsonJson *j)
+{
+	while (j->pos < j->end && (*j->pos == ' ' || *j->pos == '\n' ||
+				   *j->pos == '\r' || *j->pos == '\t'))
+		j->pos++;
+}
+
+/**
+ * Find the end of a run of string text that needs no attention: the first
+ * quote, backslash or control character. Whole words are checked at a time
+ * while none of their bytes stand out.
+ **/
+static const char *
+AsonJson_string_run(const char *pos, const char *end)
+{
+	const uint64_t ones = 0x0101010101010101ULL;
+	const uint64_t highs = 0x8080808080808080ULL;
+	uint64_t word;
+	uint64_t quote;
+	uint64_t slash;
+
+	while (end - pos >= 8) {
+		memcpy(&word, pos, 8);
+		quote = word ^ (ones * '"');
+		slash = word ^ (ones * '\\');
+
+		if ((((word - ones * 0x20) & ~word) |
+		     ((quote - ones) & ~quote) |
+		     ((slash - ones) & ~slash)) & highs)
+			break;
+
+		pos += 8;
+	}
+
+	while (pos < end && *pos != '"' && *pos != '\\' &&
+	       (unsigned char)*pos >= 0x20)
+		pos++;
+
+	return pos;
+}
+
+/**
+ * Read a JSON string. Strings with no escapes are copied as they are;
+ * others are decoded and escaped again the way the builder writes them.
+ **/
+static int
+AsonJson_string(AsonJson *j)
+{
+	const char *start = j->pos++;
+	int escaped = 0;
+	size_t len;
+	char *buf;
+	int ret;
+
+	for (;;) {
+		j->pos = AsonJson_string_run(j->pos, j->end);
+
+		if (j->pos == j->end || (unsigned char)*j->pos < 0x20)
+			return AsonJson_fail(j);
+
+		if (*j->pos == '"')
+			break;
+
+		escaped = 1;
+
+		if (++j->pos == j->end)
+			return AsonJson_fail(j);
+
+		if (*j->pos == 'u') {
+			if (j->end - j->pos < 5 || lazy_hex4(j->pos + 1) < 0)
+				return AsonJson_fail(j);
+
+			j->pos += 5;
+		} else if (*j->pos && strchr("\"\\/bfnrt", *j->pos)) {
+			j->pos++;
+		} else {
+			return AsonJson_fail(j);
+		}
+	}
+
+	j->pos++;
+
+	if (! escaped)
+		return AsonBuilder_put(j->out, start, j->pos - start);
+
+	buf = lazy_unescape(start, j->pos - start, &len);
+
+	if (! buf)
+		return -1;
+
+	ret = AsonBuilder_put_string(j->out, buf, len);
+	PyMem_Free(buf);
+	return ret;
+}
+
+/**
+ * Read a JSON number.
+ **/
+static int
+AsonJson_number(AsonJson *j)
+{
+	const char *start = j->pos;
+	const char *exp = NULL;
+
+	if (*j->pos == '-')
+		j->pos++;
+
+	if (j->pos < j->end && *j->pos == '0')
+		j->pos++;
+	else if (j->pos < j->end && isdigit((unsigned char)*j->pos))
+		while (j->pos < j->end && isdigit((unsigned char)*j->pos))
+			j->pos++;
+	else
+		return AsonJson_fail(j);
+
+	if (j->pos < j->end && *j->pos == '.') {
+		if (++j->pos == j->end || ! isdigit((unsigned char)*j->pos))
+			return AsonJson_fail(j);
+
+		while (j->pos < j->end && isdigit((unsigned char)*j->pos))
+			j->pos++;
+	}
+
+	if (j->pos < j->end && (*j->pos == 'e' || *j->pos == 'E')) {
+		exp = j->pos++;
+
+		if (j->pos < j->end && (*j->pos == '+' || *j->pos == '-'))
+			j->pos++;
+
+		if (j->pos == j->end || ! isdigit((unsigned char)*j->pos))
+			return AsonJson_fail(j);
+
+		while (j->pos < j->end && isdigit((unsigned char)*j->pos))
+			j->pos++;
+	}
+
+	if (! exp)
+		return AsonBuilder_put(j->out, start, j->pos - start);
+
+	/* Write exponents the way repr() does */
+	if (AsonBuilder_put(j->out, start, exp - start) < 0 ||
+	    AsonBuilder_putc(j->out, 'e') < 0)
+		return -1;
+
+	return AsonBuilder_put(j->out, exp + 1, j->pos - exp - 1);
+}
+
+/**
+ * Read a JSON keyword.
+ **/
+static int
+AsonJson_keyword(AsonJson *j, const char *word)
+{
+	size_t len = strlen(word);
+
+	if ((size_t)(j->end - j->pos) < len || memcmp(j->pos, word, len))
+		return AsonJson_fail(j);
+
+	j->pos += len;
+	return AsonBuilder_put(j->out, word, len);
+}
+
+/**
+ * Where one member of a JSON object was written in the builder.
+ **/
+typedef struct {
+	size_t start;
+	size_t key_len;
+	size_t end;
+} AsonJsonMember;
+
+/**
+ * Drop all but the last of the members of a JSON object with the same key,
+ * as converting a dict does. The object has been written to the builder from
+ * the brace at `open` to the end.
+ **/
+static int
+AsonJson_dedupe(AsonJson *j, size_t open, AsonJsonMember *members,
+		size_t count)
+{
+	AsonBuilderField *fields;
+	char *data = j->out->data;
+	char *drop;
+	size_t out = open + 1;
+	size_t i;
+	int dropped = 0;
+
+	if (count < 2)
+		return 0;
+
+	fields = PyMem_Malloc(count * sizeof(AsonBuilderField));
+	drop = PyMem_Malloc(count);
+
+	if (! fields || ! drop) {
+		PyMem_Free(fields);
+		PyMem_Free(drop);
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		fields[i].key = data + members[i].start;
+		fields[i].len = members[i].key_len;
+		fields[i].order = i;
+		drop[i] = 0;
+	}
+
+	qsort(fields, count, sizeof(AsonBuilderField),
+	      AsonBuilderField_compare);
+
+	/* Keys are written the same way however they were escaped */
+	for (i = 0; i + 1 < count; i++) {
+		if (fields[i].len == fields[i + 1].len &&
+		    ! memcmp(fields[i].key, fields[i + 1].key, fields[i].len)) {
+			drop[fields[i].order] = 1;
+			dropped = 1;
+		}
+	}
+
+	for (i = 0; dropped && i < count; i++) {
+		if (drop[i])
+			continue;
+
+		if (out > open + 1)
+			data[out++] = ',';
+
+		memmove(data + out, data + members[i].start,
+			members[i].end - members[i].start);
+		out += members[i].end - members[i].start;
+	}
+
+	if (dropped) {
+		data[out++] = '}';
+		j->out->len = out;
+	}
+
+	PyMem_Free(fields);
+	PyMem_Free(drop);
+	return 0;
+}
+
+/**
+ * Read one JSON value.
+ **/
+static int
+AsonJson_value(AsonJson *j)
+{
+	AsonJsonMember *members = NULL;
+	AsonJsonMember *more;
+	size_t count = 0;
+	size_t size = 0;
+	size_t open;
+	char close;
+	int ret = 0;
+
+	AsonJson_skip(j);
+
+	if (j->pos == j->end)
+		return AsonJson_fail(j);
+
+	switch (*j->pos) {
+	case '"':
+		return AsonJson_string(j);
+	case 't':
+		return AsonJson_keyword(j, "true");
+	case 'f':
+		return AsonJson_keyword(j, "false");
+	case 'n':
+		return AsonJson_keyword(j, "null");
+	case '[':
+		close = ']';
+		break;
+	case '{':
+		close = '}';
+		break;
+	default:
+		return AsonJson_number(j);
+	}
+
+	open = j->out->len;
+
+	if (AsonBuilder_putc(j->out, *j->pos++) < 0)
+		return -1;
+
+	AsonJson_skip(j);
+
+	if (j->pos < j->end && *j->pos == close) {
+		j->pos++;
+		return AsonBuilder_putc(j->out, close);
+	}
+
+	if (Py_EnterRecursiveCall(" while reading JSON"))
+		return -1;
+
+	for (;;) {
+		if (close == '}') {
+			AsonJson_skip(j);
+
+			if (j->pos == j->end || *j->pos != '"') {
+				ret = AsonJson_fail(j);
+				break;
+			}
+
+			if (count == size) {
+				size = size ? size * 2 : 8;
+				more = PyMem_Realloc(members, size *
+						     sizeof(AsonJsonMember));
+
+				if (! more) {
+					PyErr_NoMemory();
+					ret = -1;
+					break;
+				}
+
+				members = more;
+			}
+
+			members[count].start = j->out->len;
+
+			if (AsonJson_string(j) < 0) {
+				ret = -1;
+				break;
+			}
+
+			members[count].key_len = j->out->len -
+				members[count].start;
+
+			AsonJson_skip(j);
+
+			if (j->pos == j->end || *j->pos != ':') {
+				ret = AsonJson_fail(j);
+				break;
+			}
+
+			j->pos++;
+
+			if (AsonBuilder_putc(j->out, ':') < 0) {
+				ret = -1;
+				break;
+			}
+		}
+
+		if (AsonJson_value(j) < 0) {
+			ret = -1;
+			break;
+		}
+
+		if (close == '}')
+			members[count++].end = j->out->len;
+
+		AsonJson_skip(j);
+
+		if (j->pos == j->end || (*j->pos != ',' && *j->pos != close)) {
+			ret = AsonJson_fail(j);
+			break;
+		}
+
+		if (AsonBuilder_putc(j->out, *j->pos) < 0) {
+			ret = -1;
+			break;
+		}
+
+		if (*j->pos++ == close)
+			break;
+	}
+
+	if (ret == 0)
+		ret = AsonJson_dedupe(j, open, members, count);
+
+	PyMem_Free(members);
+	Py_LeaveRecursiveCall();
+	return ret;
+}
+
+/**
+ * Convert JSON text to an ASON value without making Python objects for it.
+ * The JSON is rewritten as ASON text in a builder for libason to read. Text
+ * with a NUL in it is rejected by AsonText_get().
+ **/
+static PyObject *
+ason_from_json(PyObject *self, PyObject *args)
+{
+	AsonBuilder builder;
+	AsonText text;
+	AsonJson json;
+	PyObject *source;
+	ason_t *value;
+	Ason *ret;
+
+	if (! PyArg_ParseTuple(args, "O", &source))
+		return NULL;
+
+	if (AsonText_get(&text, source) < 0)
+		return NULL;
+
+	json.text = text.text;
+	json.pos = text.text;
+	json.end = text.text + strlen(text.text);
+	json.out = &builder;
+
+	if (AsonBuilder_init(&builder, json.end - json.text) < 0) {
+		AsonText_release(&text);
+		return NULL;
+	}
+
+	if (AsonJson_value(&json) == 0) {
+		AsonJson_skip(&json);
+
+		if (json.pos != json.end)
+			AsonJson_fail(&json);
+	}
+
+	AsonText_release(&text);
+
+	if (PyErr_Occurred()) {
+		AsonBuilder_clear(&builder);
+		return NULL;
+	}
+
+	value = AsonBuilder_finish(&builder);
+
+	if (! value)
+		return NULL;
+
+	ret = Ason_alloc();
+
+	if (! ret) {
+		ason_destroy(value);
+		return NULL;
+	}
+
+	ret->value = value;
+	return (PyObject *)ret;
+}
+
+/**
+ * Parse an ASON string lazily where it is a single literal.
+ **/
+static PyObject *
+ason_parse_lazy_text(PyObject *self, PyObject *args)
+{
+	PyObject *source;
+	AsonText text;
+	Ason *ret;
+
+	if (! PyArg_ParseTuple(args, "O", &source))
+		return NULL;
+
+	if (AsonText_get(&text, source) < 0)
+		return NULL;
+
+	if (lazy_classify(text.text, 0, strlen(text.text)) >= 0)
+		return ason_parse_lazy(source, &text);
+
+	ret = Ason_alloc();
+
+	if (! ret) {
+		AsonText_release(&text);
+		return NULL;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	ret->value = ason_ns_read(NULL, text.text);
+	Py_END_ALLOW_THREADS
+
+	AsonText_release(&text);
+
+	if (ret->value)
+		return (PyObject *)ret;
+
+	Py_DECREF(ret);
+	PyErr_Format(PyExc_TypeError, "Could not parse ASON expression");
+	return NULL;
+}
+
+/**
+ * Parse an ASON string.
+ **/
+static PyObject *
+ason_parse(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *source;
+	AsonText text;
+	Ason *ret;
+	ason_ns_t *ns = NULL;
+	PyObject *item;
+	PyObject *key;
+	PyObject *hold = NULL;
+	char *str_key;
+	Py_ssize_t i;
+	ason_t *ason_item;
+
+	if (! PyArg_ParseTuple(args, "O", &source))
+		return NULL;
+
+	if (AsonText_get(&text, source) < 0)
+		return NULL;
+
+	if (! kwargs)
+		goto do_parse;
+
+	ns = ason_ns_create(ASON_NS_RAM, NULL);
+	if (! ns) {
+		PyErr_Format(PyExc_RuntimeError,
+			     "Could not create ASON namespace");
+		goto kill_namespace;
+	}
+
+	for (i = 0; PyDict_Next(kwargs, &i, &key, &item);) {
+		if (!key || !item)
+			goto kill_namespace;
+
+		if (! PyStringType_Check(key)) {
+			PyErr_Format(PyExc_TypeError, "Bad keyword list");
+			goto kill_namespace;
+		}
+
+		str_key = PyStringType_AsUTF8(key, &hold);
+
+		if (! str_key)
+			goto kill_namespace;
+
+		ason_item = pyobject_to_ason(item);
+		if (ason_ns_mkvar(ns, str_key)) {
+			PyErr_Format(PyExc_RuntimeError,
+				     "mkvar error from ASON namespace");
+			goto kill_namespace;
+		}
+
+		if (ason_ns_store(ns, str_key, ason_item)) {
+			PyErr_Format(PyExc_RuntimeError,
+				     "store error from ASON namespace");
+			goto kill_namespace;
+		}
+
+		Py_CLEAR(hold);
+	}
+
+do_parse:
+	ret = Ason_alloc();
+
+	if (! ret)
+		goto kill_namespace;
+
+	Py_BEGIN_ALLOW_THREADS
+	ret->value = ason_ns_read(ns, text.text);
+	Py_END_ALLOW_THREADS
+
+	AsonText_release(&text);
+
+	if (ret->value)
+		return (PyObject *)ret;
+
+	Py_DECREF(ret);
+	PyErr_Format(PyExc_TypeError, "Could not parse ASON expression");
+
+kill_namespace:
+	AsonText_release(&text);
+	Py_XDECREF(hold);
+	ason_ns_destroy(ns);
+	return NULL;
+}
+
+/**
+ * Check whether a word in an ASON expression is a keyword rather than a
+ * variable. Rather than keep our own list, we ask libason whether it can read
+ * the word with no namespace. Returns -1 on error.
+ **/
+static int
+is_ason_keyword(const char *word, size_t len)
+{
+	char *text = PyMem_Malloc(len + 1);
+	ason_t *value;
+
+	if (! text) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	memcpy(text, word, len);
+	text[len] = '\0';
+	value = ason_ns_read(NULL, text);
+	PyMem_Free(text);
+
+	if (! value)
+		return 0;
+
+	ason_destroy(value);
+	return 1;
+}
+
+/**
+ * Add a variable to a template's list of names if it is not there yet.
+ **/
+static int
+AsonTemplate_variable(PyObject *names, const char *word, size_t len)
+{
+	PyObject *name = PyStringType_FromStringAndSize(word, len);
+	int ret;
+
+	if (! name)
+		return -1;
+
+	ret = PySequence_Contains(names, name);
+
+	if (ret == 0)
+		ret = PyList_Append(names, name);
+
+	Py_DECREF(name);
+	return ret < 0 ? -1 : 0;
+}
+
+/**
+ * Initialize an AsonTemplate object. The expression is scanned once for the
+ * names of its variables, and each is made in the template's namespace.
+ **/
+static int
+AsonTemplate_init(AsonTemplate *self, PyObject *args, PyObject *kwds)
+{
+	PyObject *names;
+	PyObject *hold;
+	ason_ns_t *ns;
+	char *string;
+	char *text;
+	char *name;
+	size_t pos = 0;
+	size_t start;
+	size_t len;
+	Py_ssize_t i;
+	int keyword;
+	static char *kwlist[] = {"expression", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &string))
+		return -1;
+
+	len = strlen(string);
+	text = PyMem_Malloc(len + 1);
+
+	if (! text) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	memcpy(text, string, len + 1);
+	names = PyList_New(0);
+
+	if (! names) {
+		PyMem_Free(text);
+		return -1;
+	}
+
+	while (pos < len) {
+		start = pos;
+
+		if (text[pos] == '"') {
+			/* Skip string literals whole */
+			for (pos++; pos < len && text[pos] != '"'; pos++)
+				if (text[pos] == '\\' && pos + 1 < len)
+					pos++;
+
+			pos++;
+		} else if (isdigit((unsigned char)text[pos])) {
+			/* So the exponent in 1e5 isn't taken for a variable */
+			for (pos++; pos < len; pos++)
+				if (! isalnum((unsigned char)text[pos]) &&
+				    text[pos] != '.' &&
+				    ! ((text[pos] == '+' || text[pos] == '-') &&
+				       (text[pos - 1] == 'e' ||
+					text[pos - 1] == 'E')))
+					break;
+		} else if (isalpha((unsigned char)text[pos]) ||
+			   text[pos] == '_') {
+			for (pos++; pos < len; pos++)
+				if (! isalnum((unsigned char)text[pos]) &&
+				    text[pos] != '_')
+					break;
+
+			keyword = is_ason_keyword(text + start, pos - start);
+
+			if (keyword < 0 || (! keyword &&
+					    AsonTemplate_variable(names,
+								  text + start,
+								  pos - start)
+					    < 0))
+				goto fail;
+		} else {
+			pos++;
+		}
+	}
+
+	ns = ason_ns_create(ASON_NS_RAM, NULL);
+
+	if (! ns) {
+		PyErr_Format(PyExc_RuntimeError,
+			     "Could not create ASON namespace");
+		goto fail;
+	}
+
+	for (i = 0; i < PyList_GET_SIZE(names); i++) {
+		name = PyStringType_AsUTF8(PyList_GET_ITEM(names, i), &hold);
+
+		if (name && ason_ns_mkvar(ns, name))
+			PyErr_Format(PyExc_RuntimeError,
+				     "mkvar error from ASON namespace");
+
+		Py_XDECREF(hold);
+
+		if (PyErr_Occurred()) {
+			ason_ns_destroy(ns);
+			goto fail;
+		}
+	}
+
+	PyMem_Free(self->text);
+	Py_CLEAR(self->variables);
+
+	if (self->ns)
+		ason_ns_destroy(self->ns);
+
+	self->text = text;
+	self->ns = ns;
+	self->variables = PyList_AsTuple(names);
+	Py_DECREF(names);
+
+	return self->variables ? 0 : -1;
+
+fail:
+	PyMem_Free(text);
+	Py_DECREF(names);
+	return -1;
+}
+
+/**
+ * Evaluate a template with the given variable bindings. The namespace is the
+ * template's own and any thread can reach it, so the GIL is kept throughout.
+ **/
+static PyObject *
+AsonTemplate_call(AsonTemplate *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *name;
+	PyObject *value;
+	PyObject *hold;
+	ason_t *item;
+	char *str_name;
+	Py_ssize_t count;
+	Py_ssize_t i;
+	Ason *ret;
+
+	if (! self->variables) {
+		PyErr_Format(PyExc_RuntimeError,
+			     "ASON template was not initialized");
+		return NULL;
+	}
+
+	if (PyTuple_GET_SIZE(args)) {
+		PyErr_Format(PyExc_TypeError,
+			     "ASON templates take keyword arguments only");
+		return NULL;
+	}
+
+	count = PyTuple_GET_SIZE(self->variables);
+
+	if (count != (kwargs ? PyDict_Size(kwargs) : 0)) {
+		PyErr_Format(PyExc_TypeError,
+			     "ASON template takes exactly %zd variables",
+			     count);
+		return NULL;
+	}
+
+	for (i = 0; i < count; i++) {
+		name = PyTuple_GET_ITEM(self->variables, i);
+		value = PyDict_GetItemWithError(kwargs, name);
+
+		if (! value && PyErr_Occurred())
+			return NULL;
+
+		str_name = PyStringType_AsUTF8(name, &hold);
+
+		if (! str_name)
+			return NULL;
+
+		if (! value) {
+			PyErr_Format(PyExc_TypeError,
+				     "Missing value for ASON variable '%s'",
+				     str_name);
+			Py_XDECREF(hold);
+			return NULL;
+		}
+
+		/* Each store replaces the binding from the call before */
+		item = pyobject_to_ason(value);
+
+		if (! item) {
+			Py_XDECREF(hold);
+			return NULL;
+		}
+
+		if (ason_ns_store(self->ns, str_name, item)) {
+			ason_destroy(item);
+			Py_XDECREF(hold);
+			PyErr_Format(PyExc_RuntimeError,
+				     "store error from ASON namespace");
+			return NULL;
+		}
+
+		Py_XDECREF(hold);
+	}
+
+	ret = Ason_alloc();
+
+	if (! ret)
+		return NULL;
+
+	ret->value = ason_ns_read(self->ns, self->text);
+
+	if (ret->value)
+		return (PyObject *)ret;
+
+	Py_DECREF(ret);
+	PyErr_Format(PyExc_TypeError, "Could not parse ASON expression");
+	return NULL;
+}
+
+/**
+ * Compile an ASON expression into a template.
+ **/
+static PyObject *
+ason_compile(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	return PyObject_Call((PyObject *)&ason_AsonTemplateType, args, kwargs);
+}
+
+/**
+ * Parse a batch of C strings into a list of Ason objects. Entries which fail
+ * to parse become None, or raise if `raise_errors` is set. NULL entries are
+ * skipped and always become None.
+ **/
+static PyObject *
+parse_batch(char **strings, Py_ssize_t count, int release_gil,
+	    int raise_errors)
+{
+	PyObject *ret = NULL;
+	ason_t **values;
+	Ason *item;
+	Py_ssize_t i;
+
+	values = PyMem_Malloc((count ? count : 1) * sizeof(ason_t *));
+
+	if (! values)
+		return PyErr_NoMemory();
+
+	if (release_gil) {
+		Py_BEGIN_ALLOW_THREADS
+		for (i = 0; i < count; i++)
+			values[i] = strings[i] ?
+				ason_ns_read(NULL, strings[i]) : NULL;
+		Py_END_ALLOW_THREADS
+	} else {
+		for (i = 0; i < count; i++)
+			values[i] = strings[i] ?
+				ason_ns_read(NULL, strings[i]) : NULL;
+	}
+
+	for (i = 0; raise_errors && i < count; i++) {
+		if (values[i] || ! strings[i])
+			continue;
+
+		PyErr_Format(PyExc_TypeError,
+			     "Could not parse ASON expression at index %zd", i);
+		goto out;
+	}
+
+	ret = PyList_New(count);
+
+	if (! ret)
+		goto out;
+
+	for (i = 0; i < count; i++) {
+		if (! values[i]) {
+			Py_INCREF(Py_None);
+			PyList_SET_ITEM(ret, i, Py_None);
+			continue;
+		}
+
+		item = Ason_alloc();
+
+		if (! item) {
+			Py_CLEAR(ret);
+			break;
+		}
+
+		item->value = values[i];
+		values[i] = NULL;
+		PyList_SET_ITEM(ret, i, (PyObject *)item);
+	}
+
+out:
+	for (i = 0; i < count; i++)
+		ason_destroy(values[i]);
+
+	PyMem_Free(values);
+	return ret;
+}
+
+/**
+ * Turn the name of a batch error policy into whether to raise.
+ **/
+static int
+parse_batch_errors(const char *name, int *raise_errors)
+{
+	if (! name || ! strcmp(name, "none"))
+		*raise_errors = 0;
+	else if (! strcmp(name, "raise"))
+		*raise_errors = 1;
+	else {
+		PyErr_Format(PyExc_ValueError,
+			     "errors must be 'none' or 'raise'");
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Parse many ASON strings at once.
+ **/
+static PyObject *
+ason_parse_many(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *iterable;
+	PyObject *seq;
+	PyObject *ret = NULL;
+	AsonText *texts;
+	char **strings;
+	char *errors = NULL;
+	int release_gil = 1;
+	int raise_errors;
+	Py_ssize_t count;
+	Py_ssize_t got;
+	Py_ssize_t i;
+	static char *kwlist[] = {"strings", "errors", "release_gil", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "O|si", kwlist,
+					  &iterable, &errors, &release_gil))
+		return NULL;
+
+	if (parse_batch_errors(errors, &raise_errors) < 0)
+		return NULL;
+
+	seq = PySequence_Fast(iterable, "Argument must be iterable");
+
+	if (! seq)
+		return NULL;
+
+	count = PySequence_Fast_GET_SIZE(seq);
+	strings = PyMem_Malloc((count ? count : 1) * sizeof(char *));
+	texts = PyMem_Malloc((count ? count : 1) * sizeof(AsonText));
+
+	if (! strings || ! texts) {
+		PyErr_NoMemory();
+		got = 0;
+		goto out;
+	}
+
+	for (got = 0; got < count; got++) {
+		if (AsonText_get(&texts[got],
+				 PySequence_Fast_GET_ITEM(seq, got)) < 0)
+			goto out;
+
+		strings[got] = texts[got].text;
+	}
+
+	ret = parse_batch(strings, count, release_gil, raise_errors);
+
+out:
+	for (i = 0; i < got; i++)
+		AsonText_release(&texts[i]);
+
+	Py_DECREF(seq);
+	PyMem_Free(strings);
+	PyMem_Free(texts);
+	return ret;
+}
+
+/**
+ * Parse newline-delimited ASON records from a bytes-like object.
+ **/
+static PyObject *
+ason_parse_lines(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	Py_buffer view;
+	PyObject *ret = NULL;
+	char **strings = NULL;
+	char *errors = NULL;
+	char *data;
+	char *line;
+	char *end;
+	char *limit;
+	int release_gil = 1;
+	int raise_errors;
+	Py_ssize_t count = 0;
+	Py_ssize_t i;
+	static char *kwlist[] = {"data", "errors", "release_gil", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "s*|si", kwlist,
+					  &view, &errors, &release_gil))
+		return NULL;
+
+	if (parse_batch_errors(errors, &raise_errors) < 0)
+		goto out;
+
+	/* We need our own copy so each record can be NUL-terminated */
+	data = PyMem_Malloc(view.len + 1);
+
+	if (! data) {
+		PyErr_NoMemory();
+		goto out;
+	}
+
+	memcpy(data, view.buf, view.len);
+	data[view.len] = '\0';
+
+	for (i = 0; i < view.len; i++)
+		if (data[i] == '\n')
+			count++;
+
+	strings = PyMem_Malloc((count + 1) * sizeof(char *));
+
+	if (! strings) {
+		PyErr_NoMemory();
+		PyMem_Free(data);
+		goto out;
+	}
+
+	count = 0;
+	limit = data + view.len;
+
+	for (line = data; line < limit; line = end + 1) {
+		end = memchr(line, '\n', limit - line);
+
+		if (! end)
+			end = limit;
+
+		*end = '\0';
+
+		if (end > line && end[-1] == '\r')
+			end[-1] = '\0';
+
+		/* Blank lines are not records, but keep their place */
+		strings[count++] = *line ? line : NULL;
+	}
+
+	ret = parse_batch(strings, count, release_gil, raise_errors);
+	PyMem_Free(strings);
+	PyMem_Free(data);
+
+out:
+	PyBuffer_Release(&view);
+	return ret;
+}
+
+/**
+ * Complain if an AsonReader is in the middle of reading a value.
+ **/
+static int
+AsonReader_check_busy(AsonReader *self)
+{
+	if (! self->busy)
+		return 0;
+
+	PyErr_Format(PyExc_RuntimeError,
+		     "AsonReader is in use by another thread");
+	return -1;
+}
+
+/**
+ * Initialize an AsonReader object.
+ **/
+static int
+AsonReader_init(AsonReader *self, PyObject *args, PyObject *kwds)
+{
+	PyObject *source = NULL;
+	Py_ssize_t chunk_size = 65536;
+	static char *kwlist[] = {"source", "chunk_size", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwds, "|On", kwlist, &source,
+					  &chunk_size))
+		return -1;
+
+	if (AsonReader_check_busy(self) < 0)
+		return -1;
+
+	if (chunk_size <= 0) {
+		PyErr_Format(PyExc_ValueError, "chunk_size must be positive");
+		return -1;
+	}
+
+	if (source == Py_None)
+		source = NULL;
+
+	Py_CLEAR(self->source);
+	self->fd = -1;
+
+	if (source && PyIndex_Check(source)) {
+		self->fd = PyNumber_AsSsize_t(source, PyExc_OverflowError);
+
+		if (self->fd == -1 && PyErr_Occurred())
+			return -1;
+	} else if (source && ! PyObject_HasAttrString(source, "read")) {
+		PyErr_Format(PyExc_TypeError,
+			     "source must be a file descriptor or have a "
+			     "read() method");
+		return -1;
+	} else if (source) {
+		Py_INCREF(source);
+		self->source = source;
+	}
+
+	self->chunk_size = chunk_size;
+	self->start = 0;
+	self->len = 0;
+	self->scan = 0;
+	self->depth = 0;
+	self->in_string = 0;
+	self->escape = 0;
+	self->eof = 0;
+
+	return 0;
+}
+
+/**
+ * Make room for `count` more bytes plus a terminator in a reader's buffer,
+ * dropping the already consumed part first.
+ **/
+static int
+AsonReader_reserve(AsonReader *self, size_t count)
+{
+	size_t size = self->size ? self->size : 64;
+	char *buf;
+
+	if (self->start && self->len + count + 1 > self->size) {
+		memmove(self->data, self->data + self->start,
+			self->len - self->start);
+		self->len -= self->start;
+		self->scan -= self->start;
+		self->start = 0;
+	}
+
+	while (self->len + count + 1 > size)
+		size *= 2;
+
+	if (size == self->size)
+		return 0;
+
+	buf = PyMem_Realloc(self->data, size);
+
+	if (! buf) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	self->data = buf;
+	self->size = size;
+	return 0;
+}
+
+/**
+ * Complain about a NUL in a reader's input. libason would stop reading a
+ * record there and ignore the rest of it.
+ **/
+static int
+AsonReader_check_nul(const char *data, size_t count)
+{
+	if (! memchr(data, '\0', count))
+		return 0;
+
+	PyErr_Format(PyExc_ValueError, "ASON text contains a NUL byte");
+	return -1;
+}
+
+/**
+ * Append data to a reader's buffer.
+ **/
+static int
+AsonReader_append(AsonReader *self, const char *data, size_t count)
+{
+	if (AsonReader_check_nul(data, count) < 0)
+		return -1;
+
+	if (AsonReader_reserve(self, count) < 0)
+		return -1;
+
+	memcpy(self->data + self->len, data, count);
+	self->len += count;
+	return 0;
+}
+
+/**
+ * Look for the end of the next top-level record in a reader's buffer. Returns
+ * the offset of the newline ending it, or -1 if it isn't complete yet. Any
+ * newline outside strings and brackets ends a record, even if the expression
+ * on the line is unfinished, as in `1 |`; telling that apart would take
+ * libason's grammar, so records are documented as one line at the top level.
+ **/
+static Py_ssize_t
+AsonReader_scan(AsonReader *self)
+{
+	char c;
+
+	for (; self->scan < self->len; self->scan++) {
+		c = self->data[self->scan];
+
+		if (self->escape) {
+			self->escape = 0;
+		} else if (self->in_string) {
+			if (c == '\\')
+				self->escape = 1;
+			else if (c == '"')
+				self->in_string = 0;
+		} else if (c == '"') {
+			self->in_string = 1;
+		} else if (c == '[' || c == '{' || c == '(') {
+			self->depth++;
+		} else if ((c == ']' || c == '}' || c == ')') && self->depth) {
+			self->depth--;
+		} else if (c == '\n' && ! self->depth) {
+			return self->scan++;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Read another chunk from a reader's source. Returns 0 at end of input.
+ **/
+static int
+AsonReader_fill(AsonReader *self)
+{
+	PyObject *chunk;
+	PyObject *hold = NULL;
+	Py_buffer view;
+	char *data;
+	Py_ssize_t got;
+	int ret;
+
+	if (self->fd >= 0) {
+		if (AsonReader_reserve(self, self->chunk_size) < 0)
+			return -1;
+
+		Py_BEGIN_ALLOW_THREADS
+		got = read(self->fd, self->data + self->len,
+			   self->chunk_size);
+		Py_END_ALLOW_THREADS
+
+		if (got < 0) {
+			PyErr_SetFromErrno(PyExc_OSError);
+			return -1;
+		}
+
+		if (AsonReader_check_nul(self->data + self->len, got) < 0)
+			return -1;
+
+		self->len += got;
+		return got > 0;
+	}
+
+	chunk = PyObject_CallMethod(self->source, "read", "n",
+				    self->chunk_size);
+
+	if (! chunk)
+		return -1;
+
+	if (PyStringType_Check(chunk) && ! PyBytes_Check(chunk)) {
+		data = PyStringType_AsUTF8AndSize(chunk, &hold, &got);
+		ret = data ? AsonReader_append(self, data, got) : -1;
+		Py_XDECREF(hold);
+	} else if (PyObject_GetBuffer(chunk, &view, PyBUF_SIMPLE) == 0) {
+		ret = AsonReader_append(self, view.buf, view.len);
+		got = view.len;
+		PyBuffer_Release(&view);
+	} else {
+		ret = -1;
+		got = 0;
+	}
+
+	Py_DECREF(chunk);
+
+	if (ret < 0)
+		return -1;
+
+	return got > 0;
+}
+
+/**
+ * Feed more input to an AsonReader.
+ **/
+static PyObject *
+AsonReader_feed(AsonReader *self, PyObject *args)
+{
+	Py_buffer view;
+	int ret;
+
+	if (! PyArg_ParseTuple(args, "s*", &view))
+		return NULL;
+
+	if (AsonReader_check_busy(self) < 0) {
+		PyBuffer_Release(&view);
+		return NULL;
+	}
+
+	ret = AsonReader_append(self, view.buf, view.len);
+	PyBuffer_Release(&view);
+
+	if (ret < 0)
+		return NULL;
+
+	Py_RETURN_NONE;
+}
+
+/**
+ * Mark the input to an AsonReader as finished.
+ **/
+static PyObject *
+AsonReader_close(AsonReader *self)
+{
+	self->eof = 1;
+	Py_RETURN_NONE;
+}
+
+/**
+ * Read and parse the next complete value for an AsonReader.
+ **/
+static PyObject *
+AsonReader_read_next(AsonReader *self)
+{
+	Py_ssize_t end;
+	char *record;
+	int got;
+	Ason *ret;
+
+	for (;;) {
+		end = AsonReader_scan(self);
+
+		if (end < 0 && self->eof && self->start < self->len) {
+			/* Whatever is left is the last record */
+			end = self->len;
+			self->scan = self->len;
+		}
+
+		if (end < 0 && (self->eof || (! self->source &&
+					      self->fd < 0)))
+			return NULL;
+
+		if (end < 0) {
+			got = AsonReader_fill(self);
+
+			if (got < 0)
+				return NULL;
+
+			if (! got)
+				self->eof = 1;
+
+			continue;
+		}
+
+		self->data[end] = '\0';
+		record = self->data + self->start;
+		self->start = self->scan;
+
+		/* Buffer is all consumed; start over at the front next time */
+		if (self->start == self->len) {
+			self->start = 0;
+			self->len = 0;
+			self->scan = 0;
+		}
+		self->depth = 0;
+		self->in_string = 0;
+		self->escape = 0;
+
+		while (isspace((unsigned char)*record))
+			record++;
+
+		if (*record)
+			break;
+	}
+
+	ret = Ason_alloc();
+
+	if (! ret)
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	ret->value = ason_ns_read(NULL, record);
+	Py_END_ALLOW_THREADS
+
+	if (ret->value)
+		return (PyObject *)ret;
+
+	Py_DECREF(ret);
+	PyErr_Format(PyExc_TypeError, "Could not parse ASON expression");
+	return NULL;
+}
+
+/**
+ * Get the next complete value from an AsonReader.
+ **/
+static PyObject *
+AsonReader_next(AsonReader *self)
+{
+	PyObject *ret;
+
+	if (AsonReader_check_busy(self) < 0)
+		return NULL;
+
+	self->busy = 1;
+	ret = AsonReader_read_next(self);
+	self->busy = 0;
+	return ret;
+}
+
+/**
+ * Parse an ASON file by mapping it into memory.
+ **/
+static PyObject *
+ason_load(PyObject *self, PyObject *args)
+{
+	struct stat st;
+	char *path;
+	char *map;
+	size_t page;
+	size_t span;
+	Ason *ret;
+	int fd;
+
+	if (! PyArg_ParseTuple(args, "s", &path))
+		return NULL;
+
+	fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+	}
+
+	/* Reserve a zeroed span one byte longer than the file, then map the
+	 * file over the front of it, so the text is NUL-terminated in place
+	 * even when the file ends exactly on a page boundary.
+	 */
+	page = sysconf(_SC_PAGESIZE);
+	span = (st.st_size + 1 + page - 1) / page * page;
+	map = mmap(NULL, span, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (map != MAP_FAILED && st.st_size &&
+	    mmap(map, st.st_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd,
+		 0) == MAP_FAILED) {
+		munmap(map, span);
+		map = MAP_FAILED;
+	}
+
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+
+	ret = Ason_alloc();
+
+	if (! ret) {
+		munmap(map, span);
+		return NULL;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	if (memchr(map, '\0', st.st_size))
+		ret->value = NULL;
+	else
+		ret->value = ason_ns_read(NULL, map);
+
+	munmap(map, span);
+	Py_END_ALLOW_THREADS
+
+	if (ret->value)
+		return (PyObject *)ret;
+
+	Py_DECREF(ret);
+	PyErr_Format(PyExc_TypeError, "Could not parse ASON file '%s'", path);
+	return NULL;
+}
+
+/**
+ * Get the family a concrete ASON type belongs to, or -1 for types (unions,
+ * complements, wild, ...) which may hold values of several families.
+ **/
+static int
+ason_type_family(ason_type_t type)
+{
+	switch (type) {
+	case ASON_TYPE_NULL:
+		return 0;
+	case ASON_TYPE_TRUE:
+		return 1;
+	case ASON_TYPE_FALSE:
+		return 2;
+	case ASON_TYPE_NUMERIC:
+		return 3;
+	case ASON_TYPE_STRING:
+		return 4;
+	case ASON_TYPE_LIST:
+		return 5;
+	case ASON_TYPE_OBJECT:
+	case ASON_TYPE_UOBJECT:
+		return 6;
+	default:
+		return -1;
+	}
+}
+
+/**
+ * Add a schema alternative to the per-family schemas of a matcher.
+ **/
+static int
+AsonMatcher_add(AsonMatcher *self, ason_t *alt, int family)
+{
+	ason_t *tmp;
+	int i;
+
+	for (i = 0; i < ASON_MATCHER_FAMILIES; i++) {
+		if (family >= 0 && family != i)
+			continue;
+
+		tmp = self->families[i];
+
+		if (tmp)
+			self->families[i] = ason_read("? | ?", tmp, alt);
+		else
+			self->families[i] = ason_copy(alt);
+
+		ason_destroy(tmp);
+
+		if (! self->families[i]) {
+			PyErr_Format(PyExc_RuntimeError,
+				     "Could not build ASON union");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Initialize an AsonMatcher object. The schema is flattened into its union
+ * alternatives, and for each family of concrete values we keep the union of
+ * just those alternatives which could hold such a value.
+ **/
+static int
+AsonMatcher_init(AsonMatcher *self, PyObject *args, PyObject *kwds)
+{
+	PyObject *obj;
+	Py_ssize_t cache_size = 0;
+	ason_iter_t *iter;
+	ason_t *alt;
+	int ret = 0;
+	int i;
+	static char *kwlist[] = {"schema", "cache_size", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwds, "O|n", kwlist, &obj,
+					  &cache_size))
+		return -1;
+
+	ason_destroy(self->schema);
+
+	for (i = 0; i < ASON_MATCHER_FAMILIES; i++) {
+		ason_destroy(self->families[i]);
+		self->families[i] = NULL;
+	}
+
+	Py_CLEAR(self->cache);
+	self->cache_size = cache_size;
+	self->schema = pyobject_to_ason(obj);
+
+	if (! self->schema)
+		return -1;
+
+	if (cache_size > 0 && ! (self->cache = PyDict_New()))
+		return -1;
+
+	if (ason_type(self->schema) != ASON_TYPE_UNION)
+		return AsonMatcher_add(self, self->schema,
+				       ason_type_family(
+					ason_type(self->schema)));
+
+	iter = ason_iterate(self->schema);
+
+	if (! iter) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	if (ason_iter_enter(iter)) {
+		do {
+			alt = ason_iter_value(iter);
+			ret = AsonMatcher_add(self, alt,
+					      ason_type_family(
+						ason_type(alt)));
+			ason_destroy(alt);
+		} while (ret == 0 && ason_iter_next(iter));
+	}
+
+	ason_iter_destroy(iter);
+	return ret;
+}
+
+/**
+ * Check a value against a matcher's schema.
+ **/
+static int
+AsonMatcher_check(AsonMatcher *self, ason_t *value)
+{
+	int family = ason_type_family(ason_type(value));
+	ason_t *schema = self->schema;
+
+	if (family >= 0)
+		schema = self->families[family];
+
+	/* No alternative can hold anything of this family */
+	if (! schema)
+		return 0;
+
+	return ason_check_represented_in(value, schema);
+}
+
+/**
+ * Check whether a value matches a matcher's schema.
+ **/
+static PyObject *
+AsonMatcher_matches(AsonMatcher *self, PyObject *args)
+{
+	PyObject *obj;
+	PyObject *ret;
+	ason_t *value;
+	int got;
+
+	if (! PyArg_ParseTuple(args, "O", &obj))
+		return NULL;
+
+	if (! self->schema) {
+		PyErr_Format(PyExc_RuntimeError,
+			     "ASON matcher was not initialized");
+		return NULL;
+	}
+
+	if (! PyObject_TypeCheck(obj, &ason_AsonType)) {
+		value = pyobject_to_ason(obj);
+
+		if (! value)
+			return NULL;
+
+		self->misses++;
+		got = AsonMatcher_check(self, value);
+		ason_destroy(value);
+		return PyBool_FromLong(got);
+	}
+
+	if (self->cache) {
+		ret = PyDict_GetItemWithError(self->cache, obj);
+
+		if (ret) {
+			self->hits++;
+			Py_INCREF(ret);
+			return ret;
+		}
+
+		if (PyErr_Occurred())
+			return NULL;
+	}
+
+	self->misses++;
+	value = Ason_value((Ason *)obj);
+
+	if (! value)
+		return NULL;
+
+	ret = PyBool_FromLong(AsonMatcher_check(self, value));
+
+	if (! self->cache)
+		return ret;
+
+	/* Crude bound on the cache: start over when it fills up */
+	if (PyDict_Size(self->cache) >= self->cache_size)
+		PyDict_Clear(self->cache);
+
+	if (PyDict_SetItem(self->cache, obj, ret) < 0)
+		Py_CLEAR(ret);
+
+	return ret;
+}
+
+/**
+ * Empty a matcher's result cache.
+ **/
+static PyObject *
+AsonMatcher_clear_cache(AsonMatcher *self)
+{
+	if (self->cache)
+		PyDict_Clear(self->cache);
+
+	Py_RETURN_NONE;
+}
+
+/**
+ * Prepare a schema for repeated matching.
+ **/
+static PyObject *
+ason_matcher(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	return PyObject_Call((PyObject *)&ason_AsonMatcherType, args, kwargs);
+}
+
+/**
+ * Find or add the child of a node in an AsonPath for a step. Returns the
+ * child's position, or -1 on error.
+ **/
+static Py_ssize_t
+AsonPath_add_step(AsonPath *self, Py_ssize_t parent, int kind, PyObject *key,
+		  Py_ssize_t index)
+{
+	AsonPathNode *nodes;
+	AsonPathNode *node;
+	Py_ssize_t i;
+	int same;
+
+	for (i = self->nodes[parent].child; i >= 0; i = self->nodes[i].sibling) {
+		node = &self->nodes[i];
+
+		if (node->kind != kind)
+			continue;
+
+		if (kind == ASON_PATH_INDEX && node->index != index)
+			continue;
+
+		if (kind == ASON_PATH_KEY) {
+			same = PyObject_RichCompareBool(node->key, key, Py_EQ);
+
+			if (same < 0)
+				return -1;
+
+			if (! same)
+				continue;
+		}
+
+		return i;
+	}
+
+	nodes = PyMem_Realloc(self->nodes,
+			      (self->n_nodes + 1) * sizeof(AsonPathNode));
+
+	if (! nodes) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	self->nodes = nodes;
+	node = &nodes[self->n_nodes];
+	node->kind = kind;
+	node->key = key;
+	Py_XINCREF(key);
+	node->index = index;
+	node->child = -1;
+	node->sibling = nodes[parent].child;
+	node->terminal = 0;
+	node->multi = nodes[parent].multi || kind == ASON_PATH_ANY;
+	nodes[parent].child = self->n_nodes;
+
+	return self->n_nodes++;
+}
+
+/**
+ * Read a double-quoted key from a path expression. `*pos` is left after the
+ * closing quote.
+ **/
+static PyObject *
+AsonPath_quoted(const char *expr, size_t *pos)
+{
+	size_t end = *pos + 1;
+	PyObject *ret;
+
+	while (expr[end] && expr[end] != '"')
+		end += expr[end] == '\\' && expr[end + 1] ? 2 : 1;
+
+	if (! expr[end])
+		return NULL;
+
+	ret = lazy_string(expr + *pos, end + 1 - *pos);
+
+	if (! ret)
+		PyErr_Clear();
+
+	*pos = end + 1;
+	return ret;
+}
+
+/**
+ * Compile a path expression into the step tree of an AsonPath.
+ **/
+static int
+AsonPath_compile(AsonPath *self, const char *expr, Py_ssize_t path)
+{
+	Py_ssize_t node = 0;
+	Py_ssize_t index = 0;
+	PyObject *key;
+	size_t pos = 0;
+	size_t start;
+	char *end;
+	int kind;
+
+	while (expr[pos]) {
+		key = NULL;
+
+		if (expr[pos] == '[') {
+			pos++;
+
+			if (expr[pos] == '*') {
+				kind = ASON_PATH_ANY;
+				pos++;
+			} else if (expr[pos] == '"') {
+				kind = ASON_PATH_KEY;
+				key = AsonPath_quoted(expr, &pos);
+
+				if (! key)
+					goto bad;
+			} else {
+				kind = ASON_PATH_INDEX;
+				index = strtol(expr + pos, &end, 10);
+
+				if (end == expr + pos)
+					goto bad;
+
+				pos = end - expr;
+			}
+
+			if (expr[pos] != ']') {
+				Py_XDECREF(key);
+				goto bad;
+			}
+
+			pos++;
+		} else {
+			/* A leading name needs no dot */
+			if (expr[pos] == '.')
+				pos++;
+			else if (pos)
+				goto bad;
+
+			if (expr[pos] == '*') {
+				kind = ASON_PATH_ANY;
+				pos++;
+			} else if (expr[pos] == '"') {
+				kind = ASON_PATH_KEY;
+				key = AsonPath_quoted(expr, &pos);
+
+				if (! key)
+					goto bad;
+			} else {
+				kind = ASON_PATH_KEY;
+
+				for (start = pos; expr[pos] && ! strchr(".[]\"",
+							expr[pos]); pos++);
+
+				if (pos == start)
+					goto bad;
+
+				key = PyStringType_FromStringAndSize(expr + start,
+								     pos - start);
+
+				if (! key)
+					return -1;
+			}
+		}
+
+		node = AsonPath_add_step(self, node, kind, key, index);
+		Py_XDECREF(key);
+
+		if (node < 0)
+			return -1;
+	}
+
+	self->nodes[node].terminal = 1;
+	self->ends[path] = node;
+	return 0;
+
+bad:
+	PyErr_Format(PyExc_ValueError, "Bad path expression at offset %zd: %s",
+		     (Py_ssize_t)pos, expr);
+	return -1;
+}
+
+/**
+ * Initialize an AsonPath object.
+ **/
+static int
+AsonPath_init(AsonPath *self, PyObject *args, PyObject *kwds)
+{
+	PyObject *expr;
+	PyObject *hold;
+	char *str;
+	Py_ssize_t i;
+	int ret;
+
+	if (kwds && PyDict_Size(kwds)) {
+		PyErr_Format(PyExc_TypeError,
+			     "path() takes no keyword arguments");
+		return -1;
+	}
+
+	if (! PyTuple_GET_SIZE(args)) {
+		PyErr_Format(PyExc_TypeError,
+			     "path() needs at least one expression");
+		return -1;
+	}
+
+	if (self->nodes) {
+		PyErr_Format(PyExc_TypeError, "AsonPath is already compiled");
+		return -1;
+	}
+
+	self->n_paths = PyTuple_GET_SIZE(args);
+	self->ends = PyMem_Malloc(self->n_paths * sizeof(Py_ssize_t));
+	self->nodes = PyMem_Malloc(sizeof(AsonPathNode));
+
+	if (! self->ends || ! self->nodes) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	self->n_nodes = 1;
+	self->nodes[0].kind = ASON_PATH_ROOT;
+	self->nodes[0].key = NULL;
+	self->nodes[0].child = -1;
+	self->nodes[0].sibling = -1;
+	self->nodes[0].terminal = 0;
+	self->nodes[0].multi = 0;
+
+	for (i = 0; i < self->n_paths; i++) {
+		expr = PyTuple_GET_ITEM(args, i);
+
+		if (! PyStringType_Check(expr)) {
+			PyErr_Format(PyExc_TypeError,
+				     "Path expressions must be strings");
+			return -1;
+		}
+
+		str = PyStringType_AsUTF8(expr, &hold);
+
+		if (! str)
+			return -1;
+
+		ret = AsonPath_compile(self, str, i);
+		Py_XDECREF(hold);
+
+		if (ret < 0)
+			return -1;
+	}
+
+	Py_INCREF(args);
+	self->expressions = args;
+	return 0;
+}
+
+static int AsonPath_walk(AsonPath *self, Py_ssize_t node, Ason *value,
+			 PyObject **found);
+
+/**
+ * Follow a wildcard step into every member of a list or object, or every
+ * alternative of a union.
+ **/
+static int
+AsonPath_walk_any(AsonPath *self, Py_ssize_t node, Ason *value,
+		  PyObject **found)
+{
+	PyObject *child;
+	Py_ssize_t i;
+	int ret = 0;
+
+	if (Ason_index(value) < 0)
+		return -1;
+
+	for (i = 0; ret >= 0 && i < value->index_len; i++) {
+		child = Ason_index_child(value, &value->index[i]);
+
+		if (! child)
+			return -1;
+
+		ret = AsonPath_walk(self, node, (Ason *)child, found);
+		Py_DECREF(child);
+	}
+
+	return ret;
+}
+
+/**
+ * Follow the step at `node` from `value`.
+ **/
+static int
+AsonPath_step(AsonPath *self, Py_ssize_t node, Ason *value, PyObject **found)
+{
+	AsonPathNode *step = &self->nodes[node];
+	AsonIndexEntry *entry;
+	PyObject *child;
+	Py_ssize_t i;
+	int type;
+	int ret;
+
+	if (step->kind == ASON_PATH_ANY)
+		return AsonPath_walk_any(self, node, value, found);
+
+	type = Ason_index(value);
+
+	if (type < 0)
+		return -1;
+
+	if (step->kind == ASON_PATH_KEY) {
+		if (type != ASON_TYPE_OBJECT && type != ASON_TYPE_UOBJECT)
+			return 0;
+
+		entry = Ason_index_find(value, step->key);
+
+		if (! entry)
+			return PyErr_Occurred() ? -1 : 0;
+	} else {
+		if (type != ASON_TYPE_LIST)
+			return 0;
+
+		i = step->index < 0 ? step->index + value->index_len :
+			step->index;
+
+		if (i < 0 || i >= value->index_len)
+			return 0;
+
+		entry = &value->index[i];
+	}
+
+	child = Ason_index_child(value, entry);
+
+	if (! child)
+		return -1;
+
+	ret = AsonPath_walk(self, node, (Ason *)child, found);
+	Py_DECREF(child);
+	return ret;
+}
+
+/**
+ * Record `value` as found at `node` if a path ends there, then follow every
+ * step out of `node`.
+ **/
+static int
+AsonPath_walk(AsonPath *self, Py_ssize_t node, Ason *value, PyObject **found)
+{
+	Py_ssize_t child;
+
+	if (self->nodes[node].terminal) {
+		if (! self->nodes[node].multi) {
+			if (! found[node]) {
+				Py_INCREF(value);
+				found[node] = (PyObject *)value;
+			}
+		} else {
+			if (! found[node])
+				found[node] = PyList_New(0);
+
+			if (! found[node] ||
+			    PyList_Append(found[node], (PyObject *)value) < 0)
+				return -1;
+		}
+	}
+
+	for (child = self->nodes[node].child; child >= 0;
+	     child = self->nodes[child].sibling)
+		if (AsonPath_step(self, child, value, found) < 0)
+			return -1;
+
+	return 0;
+}
+
+/**
+ * Extract every path from a value. A path with a wildcard gives a list of
+ * everything it matched; any other path gives the value it reached, or the
+ * default if it reached nothing.
+ **/
+static PyObject *
+AsonPath_call(AsonPath *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = { "value", "default", NULL };
+	PyObject *obj;
+	PyObject *def = Py_None;
+	PyObject *ret = NULL;
+	PyObject *item;
+	PyObject **found;
+	Ason *value;
+	Py_ssize_t node;
+	Py_ssize_t i;
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist,
+					  &obj, &def))
+		return NULL;
+
+	if (! self->nodes) {
+		PyErr_Format(PyExc_TypeError, "AsonPath is not compiled");
+		return NULL;
+	}
+
+	if (PyObject_TypeCheck(obj, &ason_AsonType)) {
+		Py_INCREF(obj);
+		value = (Ason *)obj;
+	} else {
+		value = Ason_alloc();
+
+		if (! value)
+			return NULL;
+
+		value->value = pyobject_to_ason(obj);
+
+		if (! value->value) {
+			Py_DECREF(value);
+			return NULL;
+		}
+	}
+
+	found = PyMem_Malloc(self->n_nodes * sizeof(PyObject *));
+
+	if (! found) {
+		Py_DECREF(value);
+		return PyErr_NoMemory();
+	}
+
+	memset(found, 0, self->n_nodes * sizeof(PyObject *));
+
+	if (AsonPath_walk(self, 0, value, found) < 0)
+		goto out;
+
+	if (self->n_paths > 1 && ! (ret = PyTuple_New(self->n_paths)))
+		goto out;
+
+	for (i = 0; i < self->n_paths; i++) {
+		node = self->ends[i];
+
+		if (self->nodes[node].multi && found[node])
+			/* The same path given twice gets its own list */
+			item = PyList_GetSlice(found[node], 0,
+					       PyList_GET_SIZE(found[node]));
+		else if (self->nodes[node].multi)
+			item = PyList_New(0);
+		else
+			item = found[node] ? found[node] : def;
+
+		if (! self->nodes[node].multi)
+			Py_INCREF(item);
+
+		if (! item) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+
+		if (self->n_paths == 1)
+			ret = item;
+		else
+			PyTuple_SET_ITEM(ret, i, item);
+	}
+
+out:
+	for (i = 0; i < self->n_nodes; i++)
+		Py_XDECREF(found[i]);
+
+	PyMem_Free(found);
+	Py_DECREF(value);
+	return ret;
+}
+
+/**
+ * Compile path expressions.
+ **/
+static PyObject *
+ason_path(PyObject *self, PyObject *args)
+{
+	return PyObject_Call((PyObject *)&ason_AsonPathType, args, NULL);
+}
+
+/**
+ * Convert an Ason object to a float
+ **/
+static PyObject *
+Ason_float(Ason *self)
+{
+	ason_t *value = Ason_value(self);
+
+	if (! value)
+		return NULL;
+
+	if (ason_type(value) == ASON_TYPE_NUMERIC)
+		return Py_BuildValue("d", ason_double(value));
+
+	PyErr_Format(PyExc_TypeError, "ASON expression must be numeric");
+	return NULL;
+}
+
+/**
+ * Print an Ason object's value, in Unicode or plain ASCII notation. The
+ * result must be freed by the caller.
+ **/
+static char *
+Ason_print(Ason *self, int unicode, size_t *len)
+{
+	char *data;
+
+	ason_t *value = Ason_value(self);
+
+	if (! value)
+		return NULL;
+
+	if (unicode)
+		data = ason_asprint_unicode(value);
+	else
+		data = ason_asprint(value);
+
+	if (data)
+		*len = strlen(data);
+
+	if (! data)
+		PyErr_NoMemory();
+
+	return data;
+}
+
+/**
+ * Get an Ason object as a string in ASON format
+ **/
+static PyObject *
+Ason_serialize(Ason *self, PyObject *args, PyObject *kwargs)
+{
+	char *data;
+	size_t len;
+	int unicode = 1;
+	PyObject *ret;
+	static char *kwlist[] = {"unicode", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "|i", kwlist,
+					  &unicode))
+		return NULL;
+
+	data = Ason_print(self, unicode, &len);
+
+	if (! data)
+		return NULL;
+
+#ifdef PYTHON2
+	ret = PyString_FromStringAndSize(data, len);
+#else
+	ret = PyUnicode_DecodeUTF8(data, len, NULL);
+#endif
+
+	free(data);
+	return ret;
+}
+
+/**
+ * Get an Ason object as UTF-8 encoded bytes in ASON format
+ **/
+static PyObject *
+Ason_serialize_bytes(Ason *self, PyObject *args, PyObject *kwargs)
+{
+	char *data;
+	size_t len;
+	int unicode = 1;
+	PyObject *ret;
+	static char *kwlist[] = {"unicode", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "|i", kwlist,
+					  &unicode))
+		return NULL;
+
+	data = Ason_print(self, unicode, &len);
+
+	if (! data)
+		return NULL;
+
+	ret = PyBytes_FromStringAndSize(data, len);
+	free(data);
+	return ret;
+}
+
+/**
+ * Write an Ason object in ASON format into a writable buffer
+ **/
+static PyObject *
+Ason_serialize_into(Ason *self, PyObject *args, PyObject *kwargs)
+{
+	Py_buffer view;
+	Py_ssize_t offset = 0;
+	char *data;
+	size_t len;
+	int unicode = 1;
+	PyObject *ret = NULL;
+	static char *kwlist[] = {"buffer", "offset", "unicode", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "w*|ni", kwlist,
+					  &view, &offset, &unicode))
+		return NULL;
+
+	if (offset < 0 || offset > view.len) {
+		PyErr_Format(PyExc_ValueError, "offset out of range");
+		goto out;
+	}
+
+	data = Ason_print(self, unicode, &len);
+
+	if (! data)
+		goto out;
+
+	if (len > (size_t)(view.len - offset))
+		PyErr_Format(PyExc_ValueError,
+			     "buffer too small: %zu bytes needed, %zd "
+			     "available", len, view.len - offset);
+	else
+		ret = PyLong_FromSize_t(len);
+
+	if (ret)
+		memcpy((char *)view.buf + offset, data, len);
+
+	free(data);
+
+out:
+	PyBuffer_Release(&view);
+	return ret;
+}
+
+/**
+ * Write an Ason object in ASON format to a file-like object
+ **/
+static PyObject *
+Ason_dump(Ason *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *file;
+	PyObject *write;
+	PyObject *chunk;
+	PyObject *got;
+	Py_ssize_t chunk_size = 65536;
+	Py_ssize_t count;
+	char *data;
+	size_t len;
+	size_t pos;
+	int unicode = 1;
+	static char *kwlist[] = {"file", "unicode", "chunk_size", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "O|in", kwlist,
+					  &file, &unicode, &chunk_size))
+		return NULL;
+
+	if (chunk_size <= 0) {
+		PyErr_Format(PyExc_ValueError, "chunk_size must be positive");
+		return NULL;
+	}
+
+	write = PyObject_GetAttrString(file, "write");
+
+	if (! write)
+		return NULL;
+
+	data = Ason_print(self, unicode, &len);
+
+	if (! data) {
+		Py_DECREF(write);
+		return NULL;
+	}
+
+	for (pos = 0; pos < len; pos += count) {
+		count = chunk_size;
+
+		if ((size_t)count > len - pos)
+			count = len - pos;
+
+		chunk = PyBytes_FromStringAndSize(data + pos, count);
+		got = chunk ? PyObject_CallFunctionObjArgs(write, chunk, NULL)
+			    : NULL;
+		Py_XDECREF(chunk);
+
+		if (! got)
+			break;
+
+		Py_DECREF(got);
+	}
+
+	free(data);
+	Py_DECREF(write);
+
+	if (pos < len)
+		return NULL;
+
+	return PyLong_FromSize_t(len);
+}
+
+/**
+ * Turn the name of a fallback policy into its value.
+ **/
+static int
+parse_fallback(const char *name, ason_fallback_t *out)
+{
+	if (! name || ! strcmp(name, "error"))
+		*out = ASON_FALLBACK_ERROR;
+	else if (! strcmp(name, "ason"))
+		*out = ASON_FALLBACK_ASON;
+	else if (! strcmp(name, "string"))
+		*out = ASON_FALLBACK_STRING;
+	else {
+		PyErr_Format(PyExc_ValueError,
+			     "fallback must be 'error', 'ason' or 'string'");
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Convert a numeric value under an iterator to a Python int if it is
+ * integral, and to a float otherwise.
+ **/
+static PyObject *
+iter_number_to_python(ason_iter_t *iter)
+{
+	double dval = ason_iter_double(iter);
+
+	if (dval == floor(dval) && dval >= -9223372036854775808.0 &&
+	    dval < 9223372036854775808.0)
+		return PyLong_FromLongLong(ason_iter_long(iter));
+
+	return PyFloat_FromDouble(dval);
+}
+
+/**
+ * Convert the value under an iterator, and everything below it, to plain
+ * Python values.
+ **/
+static PyObject *
+iter_to_python(ason_iter_t *iter, ason_fallback_t fallback)
+{
+	PyObject *ret = NULL;
+	PyObject *item;
+	ason_t *value;
+	char *data;
+	int err;
+
+	switch (ason_iter_type(iter)) {
+	case ASON_TYPE_NULL:
+		Py_RETURN_NONE;
+	case ASON_TYPE_TRUE:
+		Py_RETURN_TRUE;
+	case ASON_TYPE_FALSE:
+		Py_RETURN_FALSE;
+	case ASON_TYPE_NUMERIC:
+		return iter_number_to_python(iter);
+	case ASON_TYPE_STRING:
+		data = ason_iter_string(iter);
+		ret = PyStringType_FromString(data);
+		free(data);
+		return ret;
+	case ASON_TYPE_LIST:
+		if (Py_EnterRecursiveCall(" while converting ASON to Python"))
+			return NULL;
+
+		ret = PyList_New(0);
+
+		if (ret && ason_iter_enter(iter)) {
+			do {
+				item = iter_to_python(iter, fallback);
+				err = item ? PyList_Append(ret, item) : -1;
+				Py_XDECREF(item);
+
+				if (err < 0) {
+					Py_CLEAR(ret);
+					break;
+				}
+			} while (ason_iter_next(iter));
+
+			ason_iter_exit(iter);
+		}
+
+		Py_LeaveRecursiveCall();
+		return ret;
+	case ASON_TYPE_OBJECT:
+		if (Py_EnterRecursiveCall(" while converting ASON to Python"))
+			return NULL;
+
+		ret = PyDict_New();
+
+		if (ret && ason_iter_enter(iter)) {
+			do {
+				item = iter_to_python(iter, fallback);
+				data = ason_iter_key(iter);
+				err = item ?
+					PyDict_SetItemString(ret, data, item) :
+					-1;
+				Py_XDECREF(item);
+				free(data);
+
+				if (err < 0) {
+					Py_CLEAR(ret);
+					break;
+				}
+			} while (ason_iter_next(iter));
+
+			ason_iter_exit(iter);
+		}
+
+		Py_LeaveRecursiveCall();
+		return ret;
+	default:
+		break;
+	}
+
+	if (fallback == ASON_FALLBACK_ERROR) {
+		PyErr_Format(PyExc_TypeError,
+			     "ASON value has no plain Python equivalent");
+		return NULL;
+	}
+
+	value = ason_iter_value(iter);
+
+	if (fallback == ASON_FALLBACK_STRING) {
+		data = ason_asprint_unicode(value);
+		ason_destroy(value);
+		ret = Py_BuildValue("s", data);
+		free(data);
+		return ret;
+	}
+
+	ret = (PyObject *)Ason_alloc();
+
+	if (ret)
+		((Ason *)ret)->value = value;
+	else
+		ason_destroy(value);
+
+	return ret;
+}
+
+/**
+ * Convert an ASON value to plain Python values in one pass.
+ **/
+static PyObject *
+ason_value_to_python(ason_t *value, const char *fallback_name)
+{
+	ason_fallback_t fallback;
+	ason_iter_t *iter;
+	PyObject *ret;
+
+	if (parse_fallback(fallback_name, &fallback) < 0)
+		return NULL;
+
+	iter = ason_iterate(value);
+
+	if (! iter)
+		return PyErr_NoMemory();
+
+	ret = iter_to_python(iter, fallback);
+	ason_iter_destroy(iter);
+	return ret;
+}
+
+/**
+ * Convert an Ason object to plain Python values.
+ **/
+static PyObject *
+Ason_to_python(Ason *self, PyObject *args, PyObject *kwargs)
+{
+	ason_t *value;
+	char *fallback = NULL;
+	static char *kwlist[] = {"fallback", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "|s", kwlist,
+					  &fallback))
+		return NULL;
+
+	value = Ason_value(self);
+
+	if (! value)
+		return NULL;
+
+	return ason_value_to_python(value, fallback);
+}
+
+/**
+ * Convert any ASONifiable value to plain Python values.
+ **/
+static PyObject *
+ason_to_python(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *obj;
+	PyObject *ret;
+	ason_t *value;
+	char *fallback = NULL;
+	static char *kwlist[] = {"value", "fallback", NULL};
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "O|s", kwlist,
+					  &obj, &fallback))
+		return NULL;
+
+	if (PyObject_TypeCheck(obj, &ason_AsonType)) {
+		value = Ason_value((Ason *)obj);
+		return value ? ason_value_to_python(value, fallback) : NULL;
+	}
+
+	value = pyobject_to_ason(obj);
+
+	if (! value)
+		return NULL;
+
+	ret = ason_value_to_python(value, fallback);
+	ason_destroy(value);
+	return ret;
+}
+
+/**
+ * Write the value under an iterator, and everything below it, as JSON text.
+ **/
+static int
+iter_to_json(ason_iter_t *iter, AsonBuilder *b, ason_fallback_t fallback)
+{
+	ason_type_t type = ason_iter_type(iter);
+	ason_t *value;
+	char buf[32];
+	long long lval;
+	double dval;
+	char *data;
+	int first = 1;
+	int ret = 0;
+
+	switch (type) {
+	case ASON_TYPE_NULL:
+		return AsonBuilder_put(b, "null", 4);
+	case ASON_TYPE_TRUE:
+		return AsonBuilder_put(b, "true", 4);
+	case ASON_TYPE_FALSE:
+		return AsonBuilder_put(b, "false", 5);
+	case ASON_TYPE_NUMERIC:
+		dval = ason_iter_double(iter);
+
+		/* -0.0 is whole but would lose its sign as an integer */
+		if (dval == floor(dval) && dval >= -9223372036854775808.0 &&
+		    dval < 9223372036854775808.0 &&
+		    (dval != 0 || ! signbit(dval))) {
+			lval = ason_iter_long(iter);
+			return AsonBuilder_put(b, buf, snprintf(buf,
+								sizeof(buf),
+								"%lld", lval));
+		}
+
+		if (! Py_IS_FINITE(dval))
+			break;
+
+		data = PyOS_double_to_string(dval, 'r', 0, 0, NULL);
+
+		if (! data)
+			return -1;
+
+		ret = AsonBuilder_put(b, data, strlen(data));
+		PyMem_Free(data);
+		return ret;
+	case ASON_TYPE_STRING:
+		data = ason_iter_string(iter);
+
+		if (! data) {
+			PyErr_NoMemory();
+			return -1;
+		}
+
+		ret = AsonBuilder_put_string(b, data, strlen(data));
+		free(data);
+		return ret;
+	case ASON_TYPE_LIST:
+	case ASON_TYPE_OBJECT:
+		if (Py_EnterRecursiveCall(" while converting ASON to JSON"))
+			return -1;
+
+		ret = AsonBuilder_putc(b, type == ASON_TYPE_LIST ? '[' : '{');
+
+		if (! ret && ason_iter_enter(iter)) {
+			do {
+				if (! first && AsonBuilder_putc(b, ',') < 0) {
+					ret = -1;
+					break;
+				}
+
+				first = 0;
+
+				if (type == ASON_TYPE_OBJECT) {
+					data = ason_iter_key(iter);
+					ret = data ? AsonBuilder_put_string(b,
+						data, strlen(data)) : -1;
+					free(data);
+
+					if (ret < 0 ||
+					    AsonBuilder_putc(b, ':') < 0) {
+						ret = -1;
+						break;
+					}
+				}
+
+				ret = iter_to_json(iter, b, fallback);
+			} while (ret == 0 && ason_iter_next(iter));
+
+			ason_iter_exit(iter);
+		}
+
+		Py_LeaveRecursiveCall();
+
+		if (ret < 0)
+			return -1;
+
+		return AsonBuilder_putc(b, type == ASON_TYPE_LIST ? ']' : '}');
+	default:
+		break;
+	}
+
+	if (fallback == ASON_FALLBACK_NULL)
+		return AsonBuilder_put(b, "null", 4);
+
+	if (fallback == ASON_FALLBACK_ERROR) {
+		PyErr_Format(PyExc_TypeError,
+			     "ASON value has no JSON equivalent");
+		return -1;
 	}
-#endif
 
-	if (PyObject_TypeCheck(obj, &ason_AsonType))
-		return ason_copy(((Ason *)obj)->value);
+	value = ason_iter_value(iter);
+	data = ason_asprint_unicode(value);
+	ason_destroy(value);
+
+	if (! data) {
+		PyErr_NoMemory();
+		return -1;
+	}
 
-	if (PyList_Check(obj)) {
-		size = PyList_Size(obj);
+	ret = AsonBuilder_put_string(b, data, strlen(data));
+	free(data);
+	return ret;
+}
 
-		if (size < 0)
-			return NULL;
+/**
+ * Write an ASON value as JSON text.
+ **/
+static PyObject *
+ason_value_to_json(ason_t *value, const char *fallback_name)
+{
+	ason_fallback_t fallback = ASON_FALLBACK_ERROR;
+	AsonBuilder builder;
+	ason_iter_t *iter;
+	PyObject *ret = NULL;
 
-		if (size == 0)
-			return ason_read("[]");
+	if (fallback_name && ! strcmp(fallback_name, "null")) {
+		fallback = ASON_FALLBACK_NULL;
+	} else if (parse_fallback(fallback_name, &fallback) < 0 ||
+		   fallback == ASON_FALLBACK_ASON) {
+		PyErr_Clear();
+		PyErr_Format(PyExc_ValueError,
+			     "fallback must be 'error', 'string' or 'null'");
+		return NULL;
+	}
 
-		list_data = malloc(4 + size * 2);
+	if (AsonBuilder_init(&builder, 0) < 0)
+		return NULL;
 
-		if (! list_data) {
-			PyErr_NoMemory();
-			return NULL;
-		}
+	iter = ason_iterate(value);
+
+	if (! iter) {
+		AsonBuilder_clear(&builder);
+		return PyErr_NoMemory();
+	}
 
-		list_data[0] = '?';
-		list_data[1] = '&';
-		list_data[2] = '[';
-		list_data[2 + size * 2] = ']';
-		list_data[3 + size * 2] = '\0';
+	if (iter_to_json(iter, &builder, fallback) == 0)
+		ret = PyUnicode_DecodeUTF8(builder.data, builder.len, NULL);
 
-		for (i = 3; i < (size * 2 + 3); i += 2) {
-			if (i > 3)
-				list_data[i - 1] = ',';
-			list_data[i] = 'U';
-		}
+	ason_iter_destroy(iter);
+	AsonBuilder_clear(&builder);
+	return ret;
+}
+
+/**
+ * Convert an Ason object to JSON text.
+ **/
+static PyObject *
+Ason_to_json(Ason *self, PyObject *args, PyObject *kwargs)
+{
+	ason_t *value;
+	char *fallback = NULL;
+	static char *kwlist[] = {"fallback", NULL};
 
-		ret = ASON_UNIVERSE;
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "|s", kwlist,
+					  &fallback))
+		return NULL;
 
-		for (i = 0; i < size; i++) {
-			tmp1 = ret;
-			list_data[i * 2 + 3] = '?';
+	value = Ason_value(self);
 
-			item = PyList_GetItem(obj, i);
+	if (! value)
+		return NULL;
 
-			if (! item)
-				break;
+	return ason_value_to_json(value, fallback);
+}
 
-			tmp2 = pyobject_to_ason(item);
+/**
+ * Convert any ASONifiable value to JSON text.
+ **/
+static PyObject *
+ason_to_json(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *obj;
+	PyObject *ret;
+	ason_t *value;
+	char *fallback = NULL;
+	static char *kwlist[] = {"value", "fallback", NULL};
 
-			if (! tmp2)
-				break;
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "O|s", kwlist,
+					  &obj, &fallback))
+		return NULL;
 
-			ret = ason_read(list_data, ret, tmp2);
-			ason_destroy(tmp1);
-			ason_destroy(tmp2);
+	if (PyObject_TypeCheck(obj, &ason_AsonType)) {
+		value = Ason_value((Ason *)obj);
+		return value ? ason_value_to_json(value, fallback) : NULL;
+	}
 
-			list_data[i * 2 + 3] = 'U';
-		}
+	value = pyobject_to_ason(obj);
 
-		free(list_data);
+	if (! value)
+		return NULL;
 
-		if (i < size) {
-			ason_destroy(ret);
-			return NULL;
-		}
+	ret = ason_value_to_json(value, fallback);
+	ason_destroy(value);
+	return ret;
+}
 
-		return ret;
+/**
+ * Scramble a 64-bit hash so nearby inputs spread out.
+ **/
+static uint64_t
+ason_hash_mix(uint64_t hash)
+{
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	return hash ^ (hash >> 31);
+}
+
+static int iter_hash(ason_iter_t *iter, uint64_t *out);
+
+/**
+ * Hash the operand of the complement under an iterator. libason gives no way
+ * into a complement, so we complement it again to get the operand back.
+ **/
+static int
+iter_hash_complement(ason_iter_t *iter, uint64_t *out)
+{
+	ason_iter_t *inner_iter;
+	ason_t *value;
+	ason_t *inner;
+	int ret;
+
+	value = ason_iter_value(iter);
+	inner = value ? ason_read("!?", value) : NULL;
+	ason_destroy(value);
+
+	if (! inner) {
+		PyErr_Format(PyExc_TypeError,
+			     "Could not perform ASON operation");
+		return -1;
 	}
 
-	if (PyDict_Check(obj)) {
-		ret = ason_read("{}");
+	inner_iter = ason_iterate(inner);
 
-		for (i = 0; PyDict_Next(obj, &i, &key, &item);) {
-			if (!key || !item) {
-				ason_destroy(ret);
-				return NULL;
-			}
+	if (! inner_iter) {
+		ason_destroy(inner);
+		PyErr_NoMemory();
+		return -1;
+	}
 
-			if (! PyStringType_Check(key)) {
-				PyErr_Format(PyExc_TypeError,
-			     "Cannot ASONify dict with non-string keys");
-				ason_destroy(ret);
-				return NULL;
-			}
+	if (Py_EnterRecursiveCall(" while hashing ASON")) {
+		ret = -1;
+	} else {
+		ret = iter_hash(inner_iter, out);
+		Py_LeaveRecursiveCall();
+	}
 
-			str_key = PyStringType_AsUTF8(key);
-			if (! key) {
-				ason_destroy(ret);
-				return NULL;
-			}
+	ason_iter_destroy(inner_iter);
+	ason_destroy(inner);
+	return ret;
+}
+
+/**
+ * Hash the value under an iterator without printing it. Numbers hash by
+ * value, so 1 and 1.0 agree, and object fields and union alternatives are
+ * combined without regard to order. Values beyond plain JSON data hash over
+ * their structure too: a type tag mixed with the hashes of their members,
+ * alternatives or operand. libason normalizes values, so equal values have
+ * the same structure and hash alike.
+ **/
+static int
+iter_hash(ason_iter_t *iter, uint64_t *out)
+{
+	ason_type_t type = ason_iter_type(iter);
+	uint64_t child;
+	uint64_t sum = 0;
+	long long lval;
+	double dval;
+	char *data;
+	int ret = 0;
 
-			tmp1 = pyobject_to_ason(item);
+	*out = ason_hash_mix(type + 1);
 
-			if (! tmp1) {
-				ason_destroy(ret);
-				return NULL;
-			}
+	switch (type) {
+	case ASON_TYPE_NUMERIC:
+		dval = ason_iter_double(iter);
 
-			tmp2 = ret;
-			ret = ason_read("? : { ?s: ? }", ret, str_key, tmp1);
-			ason_destroy(tmp1);
-			ason_destroy(tmp2);
+		if (dval == floor(dval) && dval >= -9223372036854775808.0 &&
+		    dval < 9223372036854775808.0) {
+			lval = ason_iter_long(iter);
+			*out ^= ason_hash_mix((uint64_t)lval);
+		} else {
+			memcpy(&child, &dval, sizeof(child));
+			*out ^= ason_hash_mix(child);
+		}
 
-			if (! ret)
-				return NULL;
+		return 0;
+	case ASON_TYPE_STRING:
+		data = ason_iter_string(iter);
+
+		if (! data) {
+			PyErr_NoMemory();
+			return -1;
 		}
 
+		*out ^= ason_fnv1a(data, strlen(data));
+		free(data);
+		return 0;
+	case ASON_TYPE_COMP:
+		ret = iter_hash_complement(iter, &child);
+		*out = ason_hash_mix(*out ^ child);
 		return ret;
+	case ASON_TYPE_LIST:
+	case ASON_TYPE_OBJECT:
+	case ASON_TYPE_UOBJECT:
+	case ASON_TYPE_UNION:
+		break;
+	default:
+		/* null, true, false, empty, universe and wild are their type */
+		return 0;
 	}
 
-	if (PyObject_HasAttrString(obj, "__ason__")) {
-		obj = PyObject_GetAttrString(obj, "__ason__");
-	} else if (PyObject_HasAttrString(obj, "__json__")) {
-		obj = PyObject_GetAttrString(obj, "__json__");
-	} else {
-		PyErr_Format(PyExc_TypeError, "Type '%s' is not ASONifiable",
-			     obj->ob_type->tp_name);
-		return NULL;
-	}
+	if (Py_EnterRecursiveCall(" while hashing ASON"))
+		return -1;
 
-	if (! obj)
-		return NULL;
+	if (ason_iter_enter(iter)) {
+		do {
+			ret = iter_hash(iter, &child);
 
-	obj = PyObject_CallFunctionObjArgs(obj, NULL);
+			if (ret)
+				break;
 
-	if (! obj)
-		return NULL;
+			if (type == ASON_TYPE_LIST) {
+				*out = ason_hash_mix(*out * 31 + child);
+				continue;
+			}
 
-	if (PyStringType_Check(obj)) {
-		str_key = PyStringType_AsUTF8(obj);
+			if (type == ASON_TYPE_UNION) {
+				sum += ason_hash_mix(child);
+				continue;
+			}
 
-		if (! str_key)
-			return NULL;
+			data = ason_iter_key(iter);
+
+			if (! data) {
+				PyErr_NoMemory();
+				ret = -1;
+				break;
+			}
 
-		return ason_read(str_key);
+			sum += ason_hash_mix(ason_fnv1a(data, strlen(data)) ^
+					     child);
+			free(data);
+		} while (ason_iter_next(iter));
+
+		ason_iter_exit(iter);
 	}
 
-	goto retry;
+	Py_LeaveRecursiveCall();
+	*out ^= sum;
+	return ret;
 }
 
 /**
- * Initialize an Ason object.
+ * Hash an Ason object, caching the result on the object. Hashes agree with
+ * ==: scalars hash like the Python values they compare equal to, and
+ * everything else is hashed over its structure.
  **/
-static int
-Ason_init(Ason *self, PyObject *args, PyObject *kwds)
+static Py_hash_t
+Ason_hash(Ason *self)
 {
+	ason_iter_t *iter;
+	ason_t *value;
 	PyObject *obj;
-	static char *kwlist[] = {"value", NULL};
+	uint64_t hash;
+	int ret;
 
-	if (! PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &obj))
+	if (self->hash != -1)
+		return self->hash;
+
+	value = Ason_value(self);
+
+	if (! value)
 		return -1;
 
-	self->value = pyobject_to_ason(obj);
+	iter = ason_iterate(value);
 
-	if (! self->value)
+	if (! iter) {
+		PyErr_NoMemory();
 		return -1;
+	}
 
-	return 0;
+	switch (ason_iter_type(iter)) {
+	case ASON_TYPE_NULL:
+	case ASON_TYPE_TRUE:
+	case ASON_TYPE_FALSE:
+	case ASON_TYPE_NUMERIC:
+	case ASON_TYPE_STRING:
+		obj = iter_to_python(iter, ASON_FALLBACK_ERROR);
+		self->hash = obj ? PyObject_Hash(obj) : -1;
+		Py_XDECREF(obj);
+		ason_iter_destroy(iter);
+		return self->hash;
+	default:
+		break;
+	}
+
+	ret = iter_hash(iter, &hash);
+	ason_iter_destroy(iter);
+
+	if (ret < 0)
+		return -1;
+
+	self->hash = (Py_hash_t)hash;
+
+	if (self->hash == -1)
+		self->hash = -2;
+
+	return self->hash;
 }
 
 /**
- * Initialize an AsonIter object.
+ * Table of interned Ason objects.
  **/
-static int
-AsonIter_init(AsonIter *self, PyObject *args, PyObject *kwds)
+static PyObject *interned = NULL;
+
+/**
+ * Get the canonical Ason object equal to a value, so repeated values can
+ * share one object and one underlying ASON value.
+ **/
+static PyObject *
+ason_intern(PyObject *self, PyObject *args)
 {
 	PyObject *obj;
-	static char *kwlist[] = {"value", NULL};
+	PyObject *ret;
+	Ason *value;
 
-	if (! PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &obj))
-		return -1;
+	if (! PyArg_ParseTuple(args, "O", &obj))
+		return NULL;
 
-	if (! PyObject_TypeCheck(obj, &ason_AsonType)) {
-		PyErr_Format(PyExc_TypeError,
-			     "Argument must be of type 'ason'");
-		return -1;
+	if (! interned)
+		interned = PyDict_New();
+
+	if (! interned)
+		return NULL;
+
+	if (PyObject_TypeCheck(obj, &ason_AsonType)) {
+		Py_INCREF(obj);
+		value = (Ason *)obj;
+	} else {
+		value = Ason_alloc();
+
+		if (! value)
+			return NULL;
+
+		value->value = pyobject_to_ason(obj);
+
+		if (! value->value) {
+			Py_DECREF(value);
+			return NULL;
+		}
 	}
 
-	self->iter = ason_iterate(((Ason *)obj)->value);
-	self->entered = 0;
-	self->halt = 0;
-	self->enter_union = 0;
+	ret = PyDict_GetItemWithError(interned, (PyObject *)value);
 
-	switch (ason_iter_type(self->iter)) {
-	case ASON_TYPE_OBJECT:
-	case ASON_TYPE_UOBJECT:
-		self->in_object = 1;
-		break;
-	default:
-		self->in_object = 0;
-		break;
-	};
+	if (ret) {
+		Py_INCREF(ret);
+		Py_DECREF(value);
+		return ret;
+	}
 
-	return 0;
+	if (PyErr_Occurred() ||
+	    PyDict_SetItem(interned, (PyObject *)value,
+			   (PyObject *)value) < 0) {
+		Py_DECREF(value);
+		return NULL;
+	}
+
+	return (PyObject *)value;
 }
 
 /**
- * Get the next value for an AsonIter.
+ * Drop every interned Ason object and cached object key.
  **/
 static PyObject *
-AsonIter_next(AsonIter *self)
+ason_clear_interned(PyObject *self)
 {
-	Ason *val;
-	PyObject *tuple;
-	char *str_key;
-	int got;
-	ason_type_t type = ason_iter_type(self->iter);
+	Py_CLEAR(interned);
+	ason_key_cache_clear();
+	Py_RETURN_NONE;
+}
 
-	if (! self->entered) {
-		self->entered = 1;
+/**
+ * Describe a free list as a dict.
+ **/
+static PyObject *
+AsonFreeList_stats(AsonFreeList *list)
+{
+	return Py_BuildValue("{s:n,s:n,s:n,s:n}", "size", list->len,
+			     "limit", list->limit, "hits", list->hits,
+			     "misses", list->misses);
+}
 
-		switch (type) {
-		case ASON_TYPE_OBJECT:
-		case ASON_TYPE_UOBJECT:
-		case ASON_TYPE_LIST:
-		case ASON_TYPE_UNION:
-			if ((type != ASON_TYPE_UNION) == (!self->enter_union)) {
-				got = ason_iter_enter(self->iter);
-				break;
-			}
-		/* fall-thru*/
-		default:
-			got = 1;
-			self->halt = 1;
-		};
-	} else {
-		/* Yes, this works in the non-collection case */
-		got = ason_iter_next(self->iter);
-	}
+/**
+ * Report on the free lists for ason and AsonIter objects.
+ **/
+static PyObject *
+ason_free_list_stats(PyObject *self)
+{
+	PyObject *ason_stats = AsonFreeList_stats(&ason_free_list);
+	PyObject *iter_stats = AsonFreeList_stats(&iter_free_list);
+	PyObject *ret = NULL;
 
-	if (! got) /* No exception. Weird right? */
+	if (ason_stats && iter_stats)
+		ret = Py_BuildValue("{s:O,s:O}", "ason", ason_stats,
+				    "iter", iter_stats);
+
+	Py_XDECREF(ason_stats);
+	Py_XDECREF(iter_stats);
+	return ret;
+}
+
+/**
+ * Change how many dead ason and AsonIter objects are kept for reuse.
+ **/
+static PyObject *
+ason_set_free_list_limit(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = { "ason", "iter", NULL };
+	Py_ssize_t ason_limit = -1;
+	Py_ssize_t iter_limit = -1;
+
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "|nn", kwlist,
+					  &ason_limit, &iter_limit))
 		return NULL;
 
-	val = PyObject_New(Ason, &ason_AsonType);
+	if (ason_limit >= 0 &&
+	    AsonFreeList_set_limit(&ason_free_list, ason_limit) < 0)
+		return NULL;
+
+	if (iter_limit >= 0 &&
+	    AsonFreeList_set_limit(&iter_free_list, iter_limit) < 0)
+		return NULL;
+
+	Py_RETURN_NONE;
+}
+
+/**
+ * Get an iterator over the alternatives of a union. The union is walked once
+ * and its alternatives kept, so iterating it again costs nothing extra. Any
+ * other value is its own only alternative.
+ **/
+static PyObject *
+Ason_iter_union(Ason *self)
+{
+	PyObject *alts;
+	PyObject *child;
+	PyObject *ret;
+	Py_ssize_t i;
+	int type = Ason_index(self);
 
-	if (! val)
+	if (type < 0)
 		return NULL;
 
-	val->value = ason_iter_value(self->iter);
+	if (type != ASON_TYPE_UNION)
+		alts = PyTuple_Pack(1, self);
+	else
+		alts = PyTuple_New(self->index_len);
 
-	if (! self->in_object)
-		return (PyObject *)val;
+	for (i = 0; alts && type == ASON_TYPE_UNION && i < self->index_len;
+	     i++) {
+		child = Ason_index_child(self, &self->index[i]);
 
-	str_key = ason_iter_key(self->iter);
+		if (! child)
+			Py_CLEAR(alts);
+		else
+			PyTuple_SET_ITEM(alts, i, child);
+	}
 
-	tuple = Py_BuildValue("(sO)", str_key, val);
-	Py_DECREF(val);
-	free(str_key);
+	if (! alts)
+		return NULL;
 
-	return tuple;
+	ret = PyObject_GetIter(alts);
+	Py_DECREF(alts);
+	return ret;
 }
 
 /**
- * Get an iterator for an Ason object.
+ * Get an AsonIter that gives just the keys or just the values of an object,
+ * or its fields with scalar values converted.
  **/
-static AsonIter *
-Ason_iterate(Ason *self)
+static PyObject *
+Ason_view(Ason *self, int mode, int plain)
 {
 	AsonIter *ret;
-	PyObject *args;
-	int got = 0;
-
-
-	args = Py_BuildValue("(O)", self);
+	int type = Ason_get_type(self);
 
-	if (! args)
+	if (type < 0)
 		return NULL;
 
-	ret = PyObject_New(AsonIter, &ason_AsonIterType);
-
-	if (ret)
-		got = AsonIter_init(ret, args, NULL);
+	if (type == ASON_TYPE_LIST && mode != ASON_ITER_VALUES) {
+		PyErr_Format(PyExc_TypeError, "ASON value is not an object");
+		return NULL;
+	}
 
-	Py_DECREF(args);
+	if (type != ASON_TYPE_LIST && type != ASON_TYPE_OBJECT &&
+	    type != ASON_TYPE_UOBJECT) {
+		PyErr_Format(PyExc_TypeError,
+			     mode == ASON_ITER_VALUES ?
+			     "ASON value is not a list or object" :
+			     "ASON value is not an object");
+		return NULL;
+	}
 
-	if (! got)
-		return ret;
+	ret = Ason_iterate(self);
 
-	Py_XDECREF(ret);
+	if (ret) {
+		ret->mode = mode;
+		ret->plain = plain;
+	}
 
-	return NULL;
+	return (PyObject *)ret;
 }
 
 /**
- * Get an iterator for an AsonIter object.
+ * Iterate the keys of an object.
  **/
-static AsonIter *
-AsonIter_iterate(AsonIter *self)
+static PyObject *
+Ason_keys(Ason *self)
 {
-	Py_INCREF(self);
-	return self;
+	return Ason_view(self, ASON_ITER_KEYS, 0);
 }
 
 /**
- * Perform an Ason operation.
+ * Iterate the values of an object or list.
  **/
 static PyObject *
-Ason_operate(Ason *self, Ason *other, const char *fmt)
+Ason_values(Ason *self, PyObject *args, PyObject *kwargs)
 {
-	Ason *ret;
-	PyObject *tmp;
-
-	ret = PyObject_New(Ason, &ason_AsonType);
+	static char *kwlist[] = { "plain", NULL };
+	int plain = 0;
 
-	if (! ret)
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "|i", kwlist, &plain))
 		return NULL;
 
-	if (! PyObject_TypeCheck(other, &ason_AsonType)) {
-		tmp = Py_BuildValue("(O)", other);
-		if (! tmp) {
-			Py_DECREF(ret);
-			return NULL;
-		}
+	return Ason_view(self, ASON_ITER_VALUES, plain);
+}
 
-		other = PyObject_New(Ason, &ason_AsonType);
-		if (! other || Ason_init(other, tmp, NULL) < 0) {
-			Py_DECREF(ret);
-			Py_DECREF(tmp);
-			return NULL;
-		}
+/**
+ * Iterate the fields of an object.
+ **/
+static PyObject *
+Ason_items(Ason *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = { "plain", NULL };
+	int plain = 0;
 
-		Py_DECREF(tmp);
-	}
+	if (! PyArg_ParseTupleAndKeywords(args, kwargs, "|i", kwlist, &plain))
+		return NULL;
 
-	ret->value = ason_read(fmt, self->value, other->value);
-	return (PyObject *)ret;
+	return Ason_view(self, ASON_ITER_ITEMS, plain);
 }
 
 /**
- * Make a universal object
+ * Get the number of members of a list or object.
  **/
-static Ason *
-ason_uobject(PyObject *self, PyObject *args, PyObject *kwargs)
+static Py_ssize_t
+Ason_length(Ason *self)
 {
-	PyObject *dict;
-	PyObject *tmp = NULL;
-	ason_t *object;
-	ason_t *ret;
-	Ason *ret_object;
+	int type = Ason_index(self);
 
-	if (! PyArg_ParseTuple(args, "|O", &tmp))
-		return NULL;
-
-	dict = PyDict_New();
+	if (type < 0)
+		return -1;
 
-	if (tmp && !PyDict_Check(tmp)) {
-		 if (PyDict_MergeFromSeq2(dict, tmp, 1) < 0)
-			return NULL;
-	} else if (tmp && PyDict_Update(dict, tmp) < 0) {
-		return NULL;
+	if (self->index_len < 0 || type == ASON_TYPE_UNION) {
+		PyErr_Format(PyExc_TypeError,
+			     "ASON value is not a list or object");
+		return -1;
 	}
 
-	if (kwargs && PyDict_Update(dict, kwargs) < 0)
-		return NULL;
+	return self->index_len;
+}
 
-	object = pyobject_to_ason(dict);
-	Py_DECREF(dict);
+/**
+ * Get an item of a list by position.
+ **/
+static PyObject *
+Ason_item(Ason *self, Py_ssize_t i)
+{
+	int type = Ason_index(self);
 
-	if (! object)
+	if (type < 0)
 		return NULL;
 
-	ret = ason_read("? : {*}", object);
-	ason_destroy(object);
-
-	ret_object = PyObject_New(Ason, &ason_AsonType);
-
-	if (! ret_object) {
-		ason_destroy(ret);
+	if (type != ASON_TYPE_LIST) {
+		PyErr_Format(PyExc_TypeError, "ASON value is not a list");
 		return NULL;
 	}
 
-	ret_object->value = ret;
+	if (i < 0 || i >= self->index_len) {
+		PyErr_Format(PyExc_IndexError, "ASON list index out of range");
+		return NULL;
+	}
 
-	return ret_object;
+	return Ason_index_child(self, &self->index[i]);
 }
 
 /**
- * Parse an ASON string.
+ * Look up a list item by position or an object field by key. Only the
+ * member asked for is parsed.
  **/
 static PyObject *
-ason_parse(PyObject *self, PyObject *args, PyObject *kwargs)
+Ason_subscript(Ason *self, PyObject *key)
 {
-	char *string;
-	Ason *ret;
-	ason_ns_t *ns = NULL;
-	PyObject *item;
-	PyObject *key;
-	char *str_key;
+	AsonIndexEntry *entry;
 	Py_ssize_t i;
-	ason_t *ason_item;
+	int type;
 
-	sweep_strings();
+	if (PyIndex_Check(key)) {
+		i = PyNumber_AsSsize_t(key, PyExc_IndexError);
 
-	if (! PyArg_ParseTuple(args, "s", &string))
-		return NULL;
+		if (i == -1 && PyErr_Occurred())
+			return NULL;
 
-	if (! kwargs)
-		goto do_parse;
+		if (i < 0 && Ason_index(self) == ASON_TYPE_LIST)
+			i += self->index_len;
 
-	ns = ason_ns_create(ASON_NS_RAM, NULL);
-	if (! ns) {
-		PyErr_Format(PyExc_RuntimeError,
-			     "Could not create ASON namespace");
-		return NULL;
+		return Ason_item(self, i);
 	}
 
-	for (i = 0; PyDict_Next(kwargs, &i, &key, &item);) {
-		if (!key || !item)
-			goto kill_namespace;
-
-		if (! PyStringType_Check(key)) {
-			PyErr_Format(PyExc_TypeError, "Bad keyword list");
-			goto kill_namespace;
-		}
-
-		str_key = PyStringType_AsUTF8(key);
+	if (! PyStringType_Check(key)) {
+		PyErr_Format(PyExc_TypeError,
+			     "ASON values are indexed by integer or string");
+		return NULL;
+	}
 
-		if (! str_key)
-			goto kill_namespace;
+	type = Ason_index(self);
 
-		ason_item = pyobject_to_ason(item);
-		if (ason_ns_mkvar(ns, str_key)) {
-			PyErr_Format(PyExc_RuntimeError,
-				     "mkvar error from ASON namespace");
-			goto kill_namespace;
-		}
+	if (type < 0)
+		return NULL;
 
-		if (ason_ns_store(ns, str_key, ason_item)) {
-			PyErr_Format(PyExc_RuntimeError,
-				     "store error from ASON namespace");
-			goto kill_namespace;
-		}
+	if (type != ASON_TYPE_OBJECT && type != ASON_TYPE_UOBJECT) {
+		PyErr_Format(PyExc_TypeError, "ASON value is not an object");
+		return NULL;
 	}
 
-do_parse:
-	ret = PyObject_New(Ason, &ason_AsonType);
-
-	if (! ret)
-		goto kill_namespace;
-
-	ret->value = ason_ns_read(ns, string);
+	entry = Ason_index_find(self, key);
 
-	if (ret->value)
-		return (PyObject *)ret;
+	if (entry)
+		return Ason_index_child(self, entry);
 
-	Py_DECREF(ret);
-	PyErr_Format(PyExc_TypeError, "Could not parse ASON expression");
+	if (! PyErr_Occurred())
+		PyErr_SetObject(PyExc_KeyError, key);
 
-kill_namespace:
-	ason_ns_destroy(ns);
 	return NULL;
 }
 
 /**
- * Convert an Ason object to a float
+ * Check whether an object has a key, or whether a list has an item equal to
+ * the given value.
  **/
-static PyObject *
-Ason_float(Ason *self)
+static int
+Ason_contains(Ason *self, PyObject *item)
 {
-	if (ason_type(self->value) == ASON_TYPE_NUMERIC)
-		return Py_BuildValue("d", ason_double(self->value));
+	AsonIndexEntry *entry;
+	PyObject *child;
+	Py_ssize_t i;
+	int type = Ason_index(self);
+	int ret;
 
-	PyErr_Format(PyExc_TypeError, "ASON expression must be numeric");
-	return NULL;
-}
+	if (type < 0)
+		return -1;
 
-/**
- * Get an Ason object as a string in ASON format
- **/
-static PyObject *
-Ason_serialize(Ason *self)
-{
-	char *data = ason_asprint_unicode(self->value);
-	PyObject *ret = Py_BuildValue("s", data);
+	if (self->index_len < 0 || type == ASON_TYPE_UNION) {
+		PyErr_Format(PyExc_TypeError,
+			     "ASON value is not a list or object");
+		return -1;
+	}
 
-	free(data);
-	return ret;
+	if (type == ASON_TYPE_LIST) {
+		for (i = 0; i < self->index_len; i++) {
+			child = Ason_index_child(self, &self->index[i]);
+
+			if (! child)
+				return -1;
+
+			ret = PyObject_RichCompareBool(child, item, Py_EQ);
+			Py_DECREF(child);
+
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	if (! PyStringType_Check(item))
+		return 0;
+
+	entry = Ason_index_find(self, item);
+
+	if (entry)
+		return 1;
+
+	return PyErr_Occurred() ? -1 : 0;
 }
 
 /**
- * Get an AsonIter object that iterates unions.
+ * Every ASON value is true, even empty lists and objects; having a length
+ * doesn't change that.
  **/
-static PyObject *
-Ason_iter_union(Ason *self)
+static int
+Ason_bool(Ason *self)
 {
-	AsonIter *ret = Ason_iterate(self);
-
-	if (ret)
-		ret->enter_union = 1;
-
-	return (PyObject *)ret;
+	return 1;
 }
 
 /**
@@ -948,10 +8101,12 @@ Ason_iter_union(Ason *self)
 static PyObject *
 Ason_is_numeric(Ason *self)
 {
-	if (ason_type(self->value) == ASON_TYPE_NUMERIC)
-		return Py_True;
-	else
-		return Py_False;
+	int type = Ason_get_type(self);
+
+	if (type < 0)
+		return NULL;
+
+	return PyBool_FromLong(type == ASON_TYPE_NUMERIC);
 }
 
 /**
@@ -960,10 +8115,12 @@ Ason_is_numeric(Ason *self)
 static PyObject *
 Ason_is_string(Ason *self)
 {
-	if (ason_type(self->value) == ASON_TYPE_STRING)
-		return Py_True;
-	else
-		return Py_False;
+	int type = Ason_get_type(self);
+
+	if (type < 0)
+		return NULL;
+
+	return PyBool_FromLong(type == ASON_TYPE_STRING);
 }
 
 /**
@@ -972,10 +8129,12 @@ Ason_is_string(Ason *self)
 static PyObject *
 Ason_is_list(Ason *self)
 {
-	if (ason_type(self->value) == ASON_TYPE_LIST)
-		return Py_True;
-	else
-		return Py_False;
+	int type = Ason_get_type(self);
+
+	if (type < 0)
+		return NULL;
+
+	return PyBool_FromLong(type == ASON_TYPE_LIST);
 }
 
 /**
@@ -984,10 +8143,12 @@ Ason_is_list(Ason *self)
 static PyObject *
 Ason_is_union(Ason *self)
 {
-	if (ason_type(self->value) == ASON_TYPE_UNION)
-		return Py_True;
-	else
-		return Py_False;
+	int type = Ason_get_type(self);
+
+	if (type < 0)
+		return NULL;
+
+	return PyBool_FromLong(type == ASON_TYPE_UNION);
 }
 
 /**
@@ -996,10 +8157,12 @@ Ason_is_union(Ason *self)
 static PyObject *
 Ason_is_complement(Ason *self)
 {
-	if (ason_type(self->value) == ASON_TYPE_UNION)
-		return Py_True;
-	else
-		return Py_False;
+	int type = Ason_get_type(self);
+
+	if (type < 0)
+		return NULL;
+
+	return PyBool_FromLong(type == ASON_TYPE_COMP);
 }
 
 /**
@@ -1008,13 +8171,13 @@ Ason_is_complement(Ason *self)
 static PyObject *
 Ason_is_object(Ason *self)
 {
-	ason_type_t type = ason_type(self->value);
+	int type = Ason_get_type(self);
 
-	if (type == ASON_TYPE_OBJECT ||
-	    type == ASON_TYPE_UOBJECT)
-		return Py_True;
-	else
-		return Py_False;
+	if (type < 0)
+		return NULL;
+
+	return PyBool_FromLong(type == ASON_TYPE_OBJECT ||
+			       type == ASON_TYPE_UOBJECT);
 }
 
 /**
@@ -1023,8 +8186,13 @@ Ason_is_object(Ason *self)
 static PyObject *
 Ason_int(Ason *self)
 {
-	if (ason_type(self->value) == ASON_TYPE_NUMERIC)
-		return Py_BuildValue("L", ason_long(self->value));
+	ason_t *value = Ason_value(self);
+
+	if (! value)
+		return NULL;
+
+	if (ason_type(value) == ASON_TYPE_NUMERIC)
+		return Py_BuildValue("L", ason_long(value));
 
 	PyErr_Format(PyExc_TypeError, "ASON expression must be numeric");
 	return NULL;
@@ -1037,77 +8205,69 @@ static PyObject *
 Ason_compare(PyObject *a, PyObject *b, int op)
 {
 	Ason *self = (Ason *)a;
+	PyObject *obj = b;
+	ason_t *value;
 	ason_t *other;
+	int owned;
+	int equal;
+	int result;
 
 	if (! PyObject_TypeCheck(self, &ason_AsonType)) {
 		self = (Ason *)b;
-		if (! PyObject_TypeCheck(self, &ason_AsonType))
-			PyErr_Format(PyExc_TypeError,
-				     "Ason comparator called on non-Ason value");
+		obj = a;
 
 		if (op == Py_LT)
-			op = Py_GE;
-		if (op == Py_GT)
-			op = Py_LE;
-		if (op == Py_LE)
 			op = Py_GT;
-		if (op == Py_GE)
+		else if (op == Py_GT)
 			op = Py_LT;
-
-		other = pyobject_to_ason(a);
-	} else {
-		other = pyobject_to_ason(b);
+		else if (op == Py_LE)
+			op = Py_GE;
+		else if (op == Py_GE)
+			op = Py_LE;
 	}
 
+	value = Ason_value(self);
+
+	if (! value)
+		return NULL;
+
+	other = ason_value_of(obj, &owned);
+
 	/* Error would be from pyobject_to_ason */
-	if (PyErr_Occurred()) {
+	if (! other) {
 		PyErr_Clear();
 
 		if (op == Py_NE)
-			goto ret_true;
+			Py_RETURN_TRUE;
 		if (op == Py_EQ)
-			goto ret_false;
+			Py_RETURN_FALSE;
 
 		PyErr_Format(PyExc_TypeError, "Type cannot be compared "
 			     "to Ason value");
 		return NULL;
 	}
 
-	if (ason_check_equal(other, self->value)) {
-		if (op == Py_EQ)
-			goto ret_true;
-		else if (op == Py_NE)
-			goto ret_false;
-		else if (op == Py_GE)
-			goto ret_true;
-		else if (op == Py_LE)
-			goto ret_true;
-	} else {
-		if (op == Py_EQ)
-			goto ret_false;
-		else if (op == Py_NE)
-			goto ret_true;
-		else if (op == Py_GE)
-			op = Py_GT;
-		else if (op == Py_LE)
-			op = Py_LT;
+	/* A value is always equal to itself */
+	if (other == value)
+		equal = 1;
+	else
+		equal = ason_check_equal(other, value);
+
+	if (op == Py_EQ || op == Py_NE || equal) {
+		result = equal != (op == Py_NE || op == Py_LT || op == Py_GT);
+		goto out;
 	}
 
-	if (op == Py_LT && ason_check_represented_in(self->value, other))
-		goto ret_true;
-	else if (op == Py_LT)
-		goto ret_false;
-	else if (ason_check_represented_in(other, self->value))
-		goto ret_true;
+	if (op == Py_LT || op == Py_LE)
+		result = ason_check_represented_in(value, other);
 	else
-		goto ret_false;
+		result = ason_check_represented_in(other, value);
+
+out:
+	if (owned)
+		ason_destroy(other);
 
-ret_true:
-	ason_destroy(other);
-	return Py_True;
-ret_false:
-	ason_destroy(other);
-	return Py_False;
+	return PyBool_FromLong(result);
 }
 
 /**
@@ -1116,7 +8276,7 @@ ret_false:
 static PyObject *
 Ason_intersect(Ason *self, Ason *other)
 {
-	return Ason_operate(self, other, "? & ?");
+	return Ason_operate((PyObject *)self, (PyObject *)other, "? & ?", 1);
 }
 
 /**
@@ -1130,7 +8290,7 @@ Ason_join(Ason *self, PyObject *args)
 	if (! PyArg_ParseTuple(args, "O", &other))
 		return NULL;
 
-	return Ason_operate(self, other, "? : ?");
+	return Ason_operate((PyObject *)self, (PyObject *)other, "? : ?", 0);
 }
 
 /**
@@ -1139,7 +8299,7 @@ Ason_join(Ason *self, PyObject *args)
 static PyObject *
 Ason_union(Ason *self, Ason *other)
 {
-	return Ason_operate(self, other, "? | ?");
+	return Ason_operate((PyObject *)self, (PyObject *)other, "? | ?", 1);
 }
 
 /**
@@ -1148,10 +8308,23 @@ Ason_union(Ason *self, Ason *other)
 static PyObject *
 Ason_complement(Ason *self)
 {
+	ason_t *value;
 	Ason *ret;
 
-	ret = PyObject_New(Ason, &ason_AsonType);
-	ret->value = ason_read("!?", self->value);
+	ret = Ason_alloc();
+
+	if (! ret)
+		return NULL;
+
+	value = Ason_value(self);
+
+	if (! value) {
+		Py_DECREF(ret);
+		return NULL;
+	}
+
+	ret->value = ason_read("!?", value);
+
 	return (PyObject *)ret;
 }
 
@@ -1160,21 +8333,155 @@ Ason_complement(Ason *self)
  **/
 static PyMethodDef asonmodule_methods[] = {
 	{"parse", (PyCFunction)ason_parse, METH_VARARGS | METH_KEYWORDS,
-		"Parse a string as an ASON value. The full ASON syntax is "
+		"Parse a string or bytes-like object (:py:class:`bytes`, "
+		":py:class:`bytearray`, :py:class:`memoryview`, "
+		":py:class:`mmap.mmap`, ...) as an ASON value. Bytes and "
+		"bytearrays are parsed in place without a copy. The full ASON "
+		"syntax is "
 		"supported, and you can use variables, whose valuese are "
 		"provided with keyword arguments. For example, "
 		"``ason.parse('{\"foo\": bar}', bar = 6)`` would yield "
 		"``ason({ \"foo\": 6 })``."},
+	{"parse_lazy", (PyCFunction)ason_parse_lazy_text, METH_VARARGS,
+		"Like :py:func:`parse`, but a single literal is only checked "
+		"for balanced brackets up front; each part is parsed when it "
+		"is first used, and iterating a list or object walks the text "
+		"without parsing the elements. Syntax errors inside a lazy "
+		"value surface on first use. Anything other than a single "
+		"literal is parsed straight away."},
 	{"uobject", (PyCFunction)ason_uobject, METH_VARARGS | METH_KEYWORDS,
 		"Create a universal object ASON value. The signature is "
 		"effectively identical to Python's :py:class:`dict`, and "
 		"returns a similar result to ``ason(dict(...))`` except that "
-		"the represented ASON value is a universal, rather than a "
+		"the result ASON value is a universal, rather than a "
 		"normal object." },
+	{"load", (PyCFunction)ason_load, METH_VARARGS,
+		"Parse the ASON file at ``path``. The file is mapped into "
+		"memory and parsed in place rather than read into a string "
+		"first."},
+	{"intern", (PyCFunction)ason_intern, METH_VARARGS,
+		"Return the canonical :py:class:`ason` object equal to "
+		"``value``, adding it to the intern table if there is none "
+		"yet. Interning repeated values lets them share one object "
+		"in memory."},
+	{"from_json", (PyCFunction)ason_from_json, METH_VARARGS,
+		"Convert JSON text, given as a string or bytes-like object, "
+		"to an ASON value. No Python objects are made for its "
+		"contents. libason can only build values from text, so the "
+		"JSON is checked in C and written out as ASON text, which "
+		"libason then reads; the text is scanned twice. Raises "
+		":py:exc:`ValueError` if the text is not valid JSON or "
+		"contains a NUL character."},
+	{"dumpb", (PyCFunction)ason_dumpb, METH_VARARGS,
+		"Encode a value in pyason's compact binary format and return "
+		"it as :py:class:`bytes`. Every kind of ASON value can be "
+		"encoded, including unions, complements, wild and universal "
+		"objects."},
+	{"loadb", (PyCFunction)ason_loadb, METH_VARARGS,
+		"Decode a value from a bytes-like object produced by "
+		":py:func:`dumpb`. Raises :py:exc:`ValueError` if the data is "
+		"corrupt."},
+	{"union", (PyCFunction)ason_union_values, METH_VARARGS,
+		"Return the union of all the arguments. It is built in one "
+		"step, so it costs about the same as parsing the result, "
+		"where folding with ``|`` copies every intermediate union."},
+	{"union_all", (PyCFunction)ason_union_all,
+		METH_VARARGS | METH_KEYWORDS,
+		"Return the union of every value in ``values``, built in one "
+		"step as for :py:func:`union`. With ``threads`` greater than "
+		"1, large inputs are copied and split between that many "
+		"threads, which run without the GIL. The union of no values is "
+		"``ason.EMPTY``."},
+	{"intersect_all", (PyCFunction)ason_intersect_all,
+		METH_VARARGS | METH_KEYWORDS,
+		"Return the intersection of every value in ``values``. "
+		"``threads`` is as for :py:func:`union_all`. The intersection "
+		"of no values is ``ason.U``."},
+	{"filter_represented", (PyCFunction)ason_filter_represented,
+		METH_VARARGS | METH_KEYWORDS,
+		"Return a list of the items of ``values`` which are represented "
+		"in ``schema`` (that is, ``value <= schema``), checked in C. "
+		"``threads`` is as for :py:func:`union_all`."},
+	{"free_list_stats", (PyCFunction)ason_free_list_stats, METH_NOARGS,
+		"Return a dict describing the free lists of dead "
+		":py:class:`ason` and iterator objects kept for reuse. For "
+		"each of ``'ason'`` and ``'iter'`` it gives the number of "
+		"objects held (``size``), the most that will be held "
+		"(``limit``), and how many allocations were served from the "
+		"list (``hits``) or not (``misses``)."},
+	{"set_free_list_limit", (PyCFunction)ason_set_free_list_limit,
+		METH_VARARGS | METH_KEYWORDS,
+		"Set how many dead :py:class:`ason` (``ason``) and iterator "
+		"(``iter``) objects are kept for reuse. A limit of 0 turns the "
+		"free list off; a negative or missing limit is left as it "
+		"is."},
+	{"clear_interned", (PyCFunction)ason_clear_interned, METH_NOARGS,
+		"Empty the table used by :py:func:`intern`, and the cache of "
+		"object key strings kept by iterators."},
+	{"parse_many", (PyCFunction)ason_parse_many,
+		METH_VARARGS | METH_KEYWORDS,
+		"Parse a sequence of strings or bytes-like objects as ASON "
+		"values, returning a list "
+		"of :py:class:`ason` objects. The whole batch is parsed in one "
+		"go, with the GIL released unless ``release_gil`` is false. "
+		"If ``errors`` is ``'none'`` (the default) entries that fail "
+		"to parse come back as ``None``; if it is ``'raise'`` a "
+		":py:exc:`TypeError` naming the first bad index is raised."},
+	{"parse_lines", (PyCFunction)ason_parse_lines,
+		METH_VARARGS | METH_KEYWORDS,
+		"Like :py:func:`parse_many`, but takes a single bytes-like "
+		"object holding one ASON record per line. There is one result "
+		"per line, so the result at index ``i`` is line ``i + 1`` of "
+		"``data``; blank lines give ``None`` and are never errors."},
+	{"compile", (PyCFunction)ason_compile, METH_VARARGS | METH_KEYWORDS,
+		"Prepare an ASON expression for repeated evaluation. The "
+		"returned :py:class:`AsonTemplate` is called with keyword "
+		"arguments to supply its variables, so ``ason.compile('{\"foo\": "
+		"bar}')(bar = 6)`` gives the same result as "
+		"``ason.parse('{\"foo\": bar}', bar = 6)``. The variables are "
+		"found and made in a namespace once, but libason has no way to "
+		"keep a parsed expression with its variables open, so each call "
+		"still parses the expression. Any bare word libason does not "
+		"read as a keyword is a variable, and must be given a value."},
+	{"to_python", (PyCFunction)ason_to_python,
+		METH_VARARGS | METH_KEYWORDS,
+		"Convert a value to plain Python data. Equivalent to "
+		"``ason(value).to_python(fallback)``, but avoids the copy when "
+		"``value`` is already an :py:class:`ason` object."},
+	{"to_json", (PyCFunction)ason_to_json, METH_VARARGS | METH_KEYWORDS,
+		"Convert a value to JSON text. Equivalent to "
+		"``ason(value).to_json(fallback)``, but avoids the copy when "
+		"``value`` is already an :py:class:`ason` object."},
+	{"matcher", (PyCFunction)ason_matcher, METH_VARARGS | METH_KEYWORDS,
+		"Prepare ``schema`` for repeated ``value <= schema`` checks "
+		"and return an :py:class:`AsonMatcher`. If ``cache_size`` is "
+		"positive, results for :py:class:`ason` values are cached, up "
+		"to that many entries, keyed on the value's hash. That only "
+		"pays when the same values are checked again and again, as "
+		"the first check of each value also has to hash it."},
+	{"path", (PyCFunction)ason_path, METH_VARARGS,
+		"Compile one or more path expressions such as "
+		"``'a.b[3].c'`` or ``'items[*].id'`` into an "
+		":py:class:`AsonPath`. Calling it with a value extracts every "
+		"path in one walk of the value."},
 	{NULL}
 };
 
 #ifndef PYTHON2
+/**
+ * Free what the ason module keeps for reuse, and the intern table, when it is
+ * torn down.
+ **/
+static void
+asonmodule_free(void *module)
+{
+	/* Interned values go on the free lists as they die, so clear first */
+	Py_CLEAR(interned);
+	ason_key_cache_clear();
+	AsonFreeList_clear(&ason_free_list);
+	AsonFreeList_clear(&iter_free_list);
+}
+
 /**
  * The ason module itself.
  **/
@@ -1183,7 +8490,11 @@ static PyModuleDef asonmodule = {
 	"ason",
 	"Module for manipulating ASON values.",
 	-1,
-	asonmodule_methods
+	asonmodule_methods,
+	NULL,
+	NULL,
+	NULL,
+	asonmodule_free
 };
 #endif
 
@@ -1214,6 +8525,18 @@ PyInit_ason(void)
 	if (PyType_Ready(&ason_AsonIterType) < 0)
 		ERR_RET;
 
+	if (PyType_Ready(&ason_AsonTemplateType) < 0)
+		ERR_RET;
+
+	if (PyType_Ready(&ason_AsonReaderType) < 0)
+		ERR_RET;
+
+	if (PyType_Ready(&ason_AsonMatcherType) < 0)
+		ERR_RET;
+
+	if (PyType_Ready(&ason_AsonPathType) < 0)
+		ERR_RET;
+
 #ifdef PYTHON2
 	m = Py_InitModule("ason", asonmodule_methods);
 #else
@@ -1222,15 +8545,19 @@ PyInit_ason(void)
 	if (m == NULL)
 		ERR_RET;
 
-	empty = PyObject_New(Ason, &ason_AsonType);
+	ason_loadb_func = PyObject_GetAttrString(m, "loadb");
+	if (! ason_loadb_func)
+		ERR_RET;
+
+	empty = Ason_alloc();
 	if (! empty)
 		goto fail_empty;
 
-	universe = PyObject_New(Ason, &ason_AsonType);
+	universe = Ason_alloc();
 	if (! universe)
 		goto fail_universe;
 
-	wild = PyObject_New(Ason, &ason_AsonType);
+	wild = Ason_alloc();
 	if (! wild)
 		goto fail_wild;
 
@@ -1240,8 +8567,17 @@ PyInit_ason(void)
 
 	Py_INCREF(&ason_AsonType);
 	Py_INCREF(&ason_AsonIterType);
+	Py_INCREF(&ason_AsonTemplateType);
+	Py_INCREF(&ason_AsonReaderType);
+	Py_INCREF(&ason_AsonMatcherType);
+	Py_INCREF(&ason_AsonPathType);
 
 	PyModule_AddObject(m, "ason", (PyObject *)&ason_AsonType);
+	PyModule_AddObject(m, "AsonTemplate",
+			   (PyObject *)&ason_AsonTemplateType);
+	PyModule_AddObject(m, "AsonReader", (PyObject *)&ason_AsonReaderType);
+	PyModule_AddObject(m, "AsonMatcher", (PyObject *)&ason_AsonMatcherType);
+	PyModule_AddObject(m, "AsonPath", (PyObject *)&ason_AsonPathType);
 	PyModule_AddObject(m, "U", (PyObject *)universe);
 	PyModule_AddObject(m, "WILD", (PyObject *)wild);
 	PyModule_AddObject(m, "EMPTY", (PyObject *)empty);
@@ -0,0 +1,64 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Compare the binary encoding with the text format.
+
+Prints the encoded size of a few documents in each format and the time to
+write and read each one back.
+"""
+
+from __future__ import print_function
+
+import timeit
+
+import ason
+
+def documents():
+    record = {"id": 12345, "name": "pyason", "score": 0.875, "tags":
+              ["a", "b", "c"], "active": True, "parent": None}
+
+    yield "records", ason.ason([dict(record, id=i) for i in range(1000)])
+    yield "numbers", ason.ason(list(range(-5000, 5000)))
+    yield "strings", ason.ason(["item %d" % i for i in range(5000)])
+    yield "union", ason.union(*[ason.ason({"k%d" % (i % 10): i})
+                                for i in range(500)])
+    yield "schema", ason.parse('{ "a": [1, *], "b": !"x" | null, * }')
+
+def run():
+    print("%-8s %10s %10s %12s %12s %12s %12s" %
+          ("doc", "text B", "binary B", "dump usec", "dumpb usec",
+           "parse usec", "loadb usec"))
+
+    for name, value in documents():
+        text = value.serialize_bytes()
+        data = ason.dumpb(value)
+        assert ason.loadb(data) == value
+
+        ops = (value.serialize_bytes, lambda: ason.dumpb(value),
+               lambda: ason.parse(text), lambda: ason.loadb(data))
+        times = [min(timeit.repeat(op, number=10, repeat=3)) / 10
+                 for op in ops]
+
+        print("%-8s %10d %10d %12.1f %12.1f %12.1f %12.1f" %
+              ((name, len(text), len(data)) +
+               tuple(t * 1e6 for t in times)))
+
+if __name__ == "__main__":
+    run()
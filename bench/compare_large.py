@@ -0,0 +1,60 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Time comparisons and set operations between two large ason values.
+
+Neither side needs copying when both operands are already ason objects, so
+these should cost only the libason operation itself.
+"""
+
+from __future__ import print_function
+
+import timeit
+
+from ason import ason
+
+def tree(n, salt):
+    return ason([{"id": i, "name": "node%d" % i, "salt": salt,
+                  "children": [i, i + 1, i + 2]} for i in range(n)])
+
+def run():
+    print("%8s %-10s %12s" % ("nodes", "operation", "usec/op"))
+
+    for n in (100, 1000, 10000, 100000):
+        a = tree(n, 0)
+        b = tree(n, 0)
+        c = tree(n, 1)
+        ops = (
+            ("a == a", lambda: a == a),
+            ("a == b", lambda: a == b),
+            ("a == c", lambda: a == c),
+            ("a <= b", lambda: a <= b),
+            ("a | a", lambda: a | a),
+            ("a | c", lambda: a | c),
+            ("a & c", lambda: a & c),
+            ("a.join(b)", lambda: a.join(b)),
+        )
+        loops = max(1, 10000 // n)
+
+        for name, op in ops:
+            t = min(timeit.repeat(op, number=loops, repeat=3)) / loops
+            print("%8d %-10s %12.1f" % (n, name, t * 1e6))
+
+if __name__ == "__main__":
+    run()
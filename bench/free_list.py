@@ -0,0 +1,59 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Time iterate-and-discard patterns with and without the wrapper free lists.
+
+Every step of these loops makes an ason wrapper (and, for objects, an
+iterator) that dies straight away, so with the free lists on most of them
+should come from a list rather than the allocator.
+"""
+
+from __future__ import print_function
+
+import timeit
+
+import ason
+
+def run():
+    items = ason.ason(list(range(1000)))
+    fields = ason.ason(dict(("f%d" % i, i) for i in range(1000)))
+    small = ason.ason([1, 2, 3])
+    ops = (
+        ("iterate list", lambda: [None for x in items]),
+        ("iterate object", lambda: [None for x in fields]),
+        ("values()", lambda: [None for x in fields.values()]),
+        ("small iters", lambda: [list(small) for i in range(300)]),
+        ("union", lambda: [small | small for i in range(300)]),
+    )
+
+    print("%-16s %12s %12s %8s" % ("pattern", "off usec", "on usec", "hits"))
+
+    for name, op in ops:
+        ason.set_free_list_limit(ason=0, iter=0)
+        off = min(timeit.repeat(op, number=100, repeat=5)) / 100
+
+        ason.set_free_list_limit(ason=256, iter=256)
+        before = ason.free_list_stats()["ason"]["hits"]
+        on = min(timeit.repeat(op, number=100, repeat=5)) / 100
+        hits = ason.free_list_stats()["ason"]["hits"] - before
+
+        print("%-16s %12.1f %12.1f %8d" % (name, off * 1e6, on * 1e6, hits))
+
+if __name__ == "__main__":
+    run()
@@ -0,0 +1,57 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+"""Compare ason.from_json with json.loads followed by ason().
+
+Prints the time each takes to turn generated JSON documents of increasing
+size into ason values.
+"""
+
+from __future__ import print_function
+
+import json
+import timeit
+
+import ason
+
+def document(n):
+    return json.dumps([{"id": i, "name": "item %d" % i, "price": i * 0.25,
+                        "tags": ["a", "b\n"], "ok": i % 2 == 0,
+                        "parent": None} for i in range(n)])
+
+def run():
+    print("%8s %10s %14s %14s %8s" % ("records", "KiB", "loads+ason ms",
+                                      "from_json ms", "speedup"))
+
+    for n in (10, 100, 1000, 10000):
+        text = document(n)
+        assert ason.from_json(text) == ason.ason(json.loads(text))
+
+        loops = max(1, 10000 // n)
+        old = min(timeit.repeat(lambda: ason.ason(json.loads(text)),
+                                number=loops, repeat=3)) / loops
+        new = min(timeit.repeat(lambda: ason.from_json(text),
+                                number=loops, repeat=3)) / loops
+
+        print("%8d %10.1f %14.3f %14.3f %7.1fx" %
+              (n, len(text) / 1024.0, old * 1e3, new * 1e3, old / new))
+
+if __name__ == "__main__":
+    run()
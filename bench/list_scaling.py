@@ -0,0 +1,43 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+"""Time ason(list) conversion for lists of growing size.
+
+Conversion should scale linearly, so the per-element time in the last column
+should stay roughly flat from 10 up to 1M elements.
+"""
+
+from __future__ import print_function
+
+import timeit
+
+from ason import ason
+
+def run():
+    print("%10s %12s %14s" % ("elements", "seconds", "ns/element"))
+
+    for n in (10, 100, 1000, 10000, 100000, 1000000):
+        data = [{"id": i, "name": "item%d" % i, "score": i * 0.5}
+                for i in range(n)]
+        loops = max(1, 100000 // n)
+        t = min(timeit.repeat(lambda: ason(data), number=loops, repeat=3))
+        t /= loops
+        print("%10d %12.6f %14.1f" % (n, t, t * 1e9 / n))
+
+if __name__ == "__main__":
+    run()
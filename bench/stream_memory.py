@@ -0,0 +1,77 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Compare peak memory of streaming a large ASON file against reading it
+whole.
+
+Each approach runs in its own interpreter so peak RSS figures are not
+polluted by one another.
+"""
+
+from __future__ import print_function
+
+import os
+import resource
+import subprocess
+import sys
+import tempfile
+import time
+
+RECORDS = 500000
+
+def whole(path):
+    import ason
+    with open(path, "rb") as f:
+        for value in ason.parse_lines(f.read()):
+            pass
+
+def stream(path):
+    import ason
+    with open(path, "rb") as f:
+        for value in ason.AsonReader(f):
+            pass
+
+def child(mode, path):
+    start = time.time()
+    {"whole": whole, "stream": stream}[mode](path)
+    elapsed = time.time() - start
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    print("%8s %10.2f %14d" % (mode, elapsed, peak))
+
+def run():
+    fd, path = tempfile.mkstemp(suffix=".ason")
+    with os.fdopen(fd, "w") as f:
+        for i in range(RECORDS):
+            f.write('{"id": %d, "name": "record %d", "vals": [1, 2, 3]}\n'
+                    % (i, i))
+
+    try:
+        print("%d records, %d bytes" % (RECORDS, os.path.getsize(path)))
+        print("%8s %10s %14s" % ("mode", "seconds", "peak RSS (KiB)"))
+        sys.stdout.flush()
+        for mode in ("whole", "stream"):
+            subprocess.check_call([sys.executable, __file__, mode, path])
+    finally:
+        os.unlink(path)
+
+if __name__ == "__main__":
+    if len(sys.argv) == 3:
+        child(sys.argv[1], sys.argv[2])
+    else:
+        run()
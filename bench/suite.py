@@ -0,0 +1,234 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Benchmark suite for the hot paths of pyason, with the json module as a
+baseline where it has an equivalent.
+
+Every case runs in its own interpreter so the peak memory figure (growth in
+peak RSS while the case runs) belongs to that case alone. The data is
+generated from a fixed seed, so runs on the same machine are comparable:
+save one run with --json and check a later build against it with
+--baseline.
+
+    python bench/suite.py [--quick] [--sizes 100,1000] [--cases parse,union]
+                          [--json out.json] [--baseline old.json]
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import random
+import resource
+import subprocess
+import sys
+import time
+
+SEED = 1234
+MIN_TIME = 0.2
+
+def records(n):
+    rand = random.Random(SEED)
+    return [{"id": i,
+             "name": "record %d" % rand.randrange(1000000),
+             "score": rand.random() * 100,
+             "active": rand.random() < 0.5,
+             "tags": [rand.choice("abcdef") for j in range(4)],
+             "owner": {"uid": rand.randrange(1000), "group": None}}
+            for i in range(n)]
+
+def walk(value):
+    for item in value:
+        if isinstance(item, tuple):
+            item = item[1]
+        if item.is_list() or item.is_object():
+            walk(item)
+
+def walk_python(value):
+    items = value.values() if isinstance(value, dict) else value
+    for item in items:
+        if isinstance(item, (dict, list)):
+            walk_python(item)
+
+def case_convert(n, impl):
+    data = records(n)
+    if impl == "json":
+        return lambda: json.dumps(data)
+    import ason
+    return lambda: ason.ason(data)
+
+def case_parse(n, impl):
+    text = json.dumps(records(n))
+    if impl == "json":
+        return lambda: json.loads(text)
+    import ason
+    return lambda: ason.parse(text)
+
+def case_serialize(n, impl):
+    data = records(n)
+    if impl == "json":
+        return lambda: json.dumps(data)
+    import ason
+    value = ason.ason(data)
+    return lambda: value.serialize()
+
+def case_repr(n, impl):
+    import ason
+    value = ason.ason(records(n))
+    return lambda: repr(value)
+
+def case_iterate(n, impl):
+    data = records(n)
+    if impl == "json":
+        return lambda: walk_python(data)
+    import ason
+    value = ason.ason(data)
+    return lambda: walk(value)
+
+def case_union(n, impl):
+    import ason
+    a = ason.ason(records(n))
+    b = ason.ason(records(n)[::-1])
+    return lambda: a | b
+
+def case_intersect(n, impl):
+    import ason
+    a = ason.ason(records(n))
+    b = ason.ason(records(n)[::-1])
+    return lambda: a & b
+
+def case_complement(n, impl):
+    import ason
+    a = ason.ason(records(n))
+    return lambda: ~a
+
+def case_join(n, impl):
+    import ason
+    a = ason.ason(records(n))
+    b = ason.ason(records(n)[::-1])
+    return lambda: a.join(b)
+
+def case_represented(n, impl):
+    import ason
+    value = ason.ason(records(n))
+    schema = ason.parse('[{"id": U, "name": U, *}]')
+    return lambda: value <= schema
+
+# name -> (setup, has a json baseline)
+CASES = [
+    ("convert", case_convert, True),
+    ("parse", case_parse, True),
+    ("serialize", case_serialize, True),
+    ("repr", case_repr, False),
+    ("iterate", case_iterate, True),
+    ("union", case_union, False),
+    ("intersect", case_intersect, False),
+    ("complement", case_complement, False),
+    ("join", case_join, False),
+    ("represented", case_represented, False),
+]
+
+def peak_kib():
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+def child(name, n, impl):
+    setup = dict((c[0], c[1]) for c in CASES)[name]
+    op = setup(n, impl)
+    nbytes = len(json.dumps(records(n)))
+    before = peak_kib()
+
+    loops = 0
+    start = time.time()
+    while True:
+        op()
+        loops += 1
+        elapsed = time.time() - start
+        if elapsed >= MIN_TIME:
+            break
+
+    print(json.dumps({"ops": loops / elapsed,
+                      "mbps": nbytes * loops / elapsed / 1e6,
+                      "peak_kib": peak_kib() - before}))
+
+def measure(name, n, impl):
+    out = subprocess.check_output([sys.executable, __file__, "--child",
+                                   name, str(n), impl])
+    return json.loads(out.decode("ascii"))
+
+def run(args):
+    sizes = [int(s) for s in args.sizes.split(",")]
+    if args.quick:
+        sizes = sizes[:2]
+    wanted = args.cases.split(",") if args.cases else None
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    results = {}
+    print("%-12s %8s %6s %12s %10s %10s %9s %9s" %
+          ("case", "size", "impl", "ops/s", "MB/s", "peak KiB",
+           "vs json", "vs base"))
+
+    for name, setup, has_json in CASES:
+        if wanted and name not in wanted:
+            continue
+        for n in sizes:
+            row = {"ason": measure(name, n, "ason")}
+            if has_json:
+                row["json"] = measure(name, n, "json")
+
+            key = "%s/%d" % (name, n)
+            results[key] = row
+
+            for impl in ("ason", "json"):
+                if impl not in row:
+                    continue
+                r = row[impl]
+                vs_json = "-"
+                if impl == "ason" and "json" in row:
+                    vs_json = "%.2fx" % (r["ops"] / row["json"]["ops"])
+                vs_base = "-"
+                if impl in baseline.get(key, {}):
+                    vs_base = "%+.1f%%" % (
+                        (r["ops"] / baseline[key][impl]["ops"] - 1) * 100)
+                print("%-12s %8d %6s %12.1f %10.2f %10d %9s %9s" %
+                      (name, n, impl, r["ops"], r["mbps"], r["peak_kib"],
+                       vs_json, vs_base))
+            sys.stdout.flush()
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=1, sort_keys=True)
+
+if __name__ == "__main__":
+    if len(sys.argv) == 5 and sys.argv[1] == "--child":
+        child(sys.argv[2], int(sys.argv[3]), sys.argv[4])
+        sys.exit(0)
+
+    parser = argparse.ArgumentParser(description="pyason benchmark suite")
+    parser.add_argument("--sizes", default="100,1000,10000",
+                        help="comma-separated record counts")
+    parser.add_argument("--quick", action="store_true",
+                        help="only run the two smallest sizes")
+    parser.add_argument("--cases", help="comma-separated cases to run")
+    parser.add_argument("--json", help="save results to this file")
+    parser.add_argument("--baseline",
+                        help="compare against results saved with --json")
+    run(parser.parse_args())
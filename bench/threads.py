@@ -0,0 +1,73 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Measure how parsing and <= checks scale across threads.
+
+Parsing runs with the GIL released, so its throughput should grow close to
+linearly with the thread count up to the number of cores. Checks on shared
+values keep the GIL, and are shown for comparison.
+"""
+
+from __future__ import print_function
+
+import multiprocessing
+import threading
+import time
+
+import ason
+
+DOC = '{"id": 12, "tags": ["a", "b", "c"], "pos": {"x": 1.5, "y": 2.5}, ' \
+      '"name": "something fairly long to make the parse non-trivial"}'
+SCHEMA = ason.parse('{"id": U, "tags": U, "pos": {"x": U, "y": U, *}, *}')
+VALUE = ason.parse(DOC)
+CALLS = 20000
+
+def parse_work():
+    for _ in range(CALLS):
+        ason.parse(DOC)
+
+def check_work():
+    for _ in range(CALLS):
+        VALUE <= SCHEMA
+
+def measure(work, threads):
+    workers = [threading.Thread(target=work) for _ in range(threads)]
+    start = time.time()
+    for w in workers:
+        w.start()
+    for w in workers:
+        w.join()
+    return threads * CALLS / (time.time() - start)
+
+def run():
+    cores = multiprocessing.cpu_count()
+    counts = sorted(set([1, 2, 4, 8, cores]))
+    counts = [c for c in counts if c <= cores]
+
+    for name, work in (("parse", parse_work), ("<=", check_work)):
+        base = None
+        print("%s:" % name)
+        print("%8s %14s %8s" % ("threads", "ops/sec", "speedup"))
+        for count in counts:
+            rate = measure(work, count)
+            base = base or rate
+            print("%8d %14.0f %8.2f" % (count, rate, rate / base))
+
+if __name__ == "__main__":
+    run()
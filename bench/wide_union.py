@@ -0,0 +1,53 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Time building and walking wide unions.
+
+Folding with | copies the union built so far at every step, so it grows
+quadratically; ason.union() builds the whole union in one read.
+"""
+
+from __future__ import print_function
+
+import functools
+import operator
+import timeit
+
+import ason
+
+def run():
+    print("%8s %12s %12s %12s" % ("width", "fold usec", "union usec",
+                                  "iter usec"))
+
+    for n in (10, 100, 1000, 10000):
+        values = [ason.ason({"id": i}) for i in range(n)]
+        fold = lambda: functools.reduce(operator.or_, values)
+        build = lambda: ason.union(*values)
+        wide = build()
+        walk = lambda: [None for alt in wide.iter_union()]
+
+        loops = max(1, 1000 // n)
+        times = [min(timeit.repeat(op, number=loops, repeat=3)) / loops
+                 for op in (fold, build, walk)]
+
+        print("%8d %12.1f %12.1f %12.1f" % ((n,) + tuple(t * 1e6
+                                                          for t in times)))
+
+if __name__ == "__main__":
+    run()
@@ -20,7 +20,7 @@ from distutils.core import setup, Extension
 
 ason_module = Extension('ason',
         sources = ['asonmodule.c'],
-        libraries = ['ason'])
+        libraries = ['ason', 'pthread'])
 
 setup(name = 'pyason',
       version = '0.1',
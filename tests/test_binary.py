@@ -0,0 +1,92 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+"""Round trips through dumpb and loadb."""
+
+import math
+import unittest
+
+import ason
+
+def round_trip(value):
+    return ason.loadb(ason.dumpb(value))
+
+class BinaryRoundTrip(unittest.TestCase):
+    def check(self, value):
+        self.assertEqual(round_trip(value), value)
+
+    def test_scalars(self):
+        for value in (None, True, False, 0, -1, 1 << 40, 2.5, "",
+                      u"caf\xe9", "quote \" and \\ and\nnewline"):
+            self.check(ason.ason(value))
+
+    def test_containers(self):
+        self.check(ason.parse('[1, [2, "x"], {"a": null}]'))
+        self.check(ason.parse('{"a": 1, "b": {"a": 2}, "c": [{"a": 3}]}'))
+        self.check(ason.parse('{"a": 1, *}'))
+        self.check(ason.parse('{*}'))
+        self.check(ason.parse('[]'))
+        self.check(ason.parse('{}'))
+
+    def test_special_values(self):
+        self.check(ason.EMPTY)
+        self.check(ason.U)
+        self.check(ason.WILD)
+
+    def test_unions(self):
+        self.check(ason.parse('1 | "a" | [2]'))
+        self.check(ason.parse('{"a": 1 | 2, *} | null'))
+        self.check(ason.parse('[1 | [2 | 3]]'))
+        self.check(ason.union(*[ason.ason({"k%d" % i: i})
+                                for i in range(50)]))
+
+    def test_complements(self):
+        self.check(~ason.ason(6))
+        self.check(ason.parse('!{"a": 1, *}'))
+        self.check(ason.parse('{"a": !"x"}'))
+        self.check(ason.parse('!"x" | !(1 | 2)'))
+        self.check(~~ason.parse('[1, 2]'))
+
+    def test_negative_zero(self):
+        value = round_trip(ason.ason(-0.0))
+        self.assertEqual(math.copysign(1.0, float(value)), -1.0)
+
+        value = round_trip(ason.ason([0.0, -0.0])).to_python()
+        self.assertEqual([math.copysign(1.0, v) for v in value],
+                         [1.0, -1.0])
+
+    def test_non_finite(self):
+        for number in (float("inf"), float("-inf")):
+            self.assertEqual(float(round_trip(ason.ason(number))), number)
+
+        self.assertTrue(math.isnan(float(round_trip(
+            ason.ason(float("nan"))))))
+
+        value = round_trip(ason.ason({"a": [float("inf"), 1.5]}))
+        self.assertEqual(value.to_python(), {"a": [float("inf"), 1.5]})
+
+    def test_corrupt(self):
+        data = ason.dumpb(ason.parse('{"a": [1, 2 | 3]}'))
+
+        for end in range(len(data)):
+            self.assertRaises(ValueError, ason.loadb, data[:end])
+
+        self.assertRaises(ValueError, ason.loadb, data + b"\0")
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,99 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+"""Reading JSON with from_json."""
+
+import json
+import unittest
+
+import ason
+
+class FromJson(unittest.TestCase):
+    def check(self, text):
+        self.assertEqual(ason.from_json(text).to_python(), json.loads(text))
+        self.assertEqual(ason.from_json(text.encode("utf-8")).to_python(),
+                         json.loads(text))
+
+    def test_scalars(self):
+        for text in ('null', 'true', 'false', '0', '"x"', ' 7 ', '""'):
+            self.check(text)
+
+    def test_containers(self):
+        self.check('[1, [2, "x"], {"a": null}]')
+        self.check('{"a": 1, "b": {"a": 2}, "c": [{"a": 3}]}')
+        self.check('[]')
+        self.check('{}')
+        self.check(' \t\r\n[ \n1 ,\t2 ]\n')
+
+    def test_escapes(self):
+        self.check(r'"quote \" slash \\ solidus \/"')
+        self.check(r'"\b\f\n\r\t"')
+        self.check(r'"\u0041\u00e9\u20AC"')
+        self.check(r'"\u001f"')
+        self.check(r'{"a": "\"\\"}')
+
+    def test_surrogate_pairs(self):
+        value = ason.from_json(r'"\ud83d\ude00"').to_python()
+        self.assertEqual(value, u"\U0001f600")
+
+        value = ason.from_json(r'["a\uD834\uDD1Eb"]').to_python()
+        self.assertEqual(value, [u"a\U0001d11eb"])
+
+    def test_raw_utf8(self):
+        self.check(u'"caf\xe9 \U0001f600"')
+
+    def test_long_strings(self):
+        # Runs longer than a word are scanned a word at a time
+        for n in range(20):
+            self.check('"%s"' % ("x" * n))
+            self.check('"%s\\n%s"' % ("y" * n, "z" * n))
+            self.check('"%s\\"%s"' % ("y" * n, "z" * n))
+
+    def test_duplicate_keys(self):
+        value = ason.from_json('{"a": 1, "b": 2, "a": 3}')
+        self.assertEqual(value.to_python(), {"a": 3, "b": 2})
+        self.assertEqual(value, ason.ason({"a": 3, "b": 2}))
+
+        value = ason.from_json(r'{"a": 1, "a": 2}')
+        self.assertEqual(value.to_python(), {"a": 2})
+
+        value = ason.from_json('{"x": {"a": 1, "a": [1]}, "x": 0}')
+        self.assertEqual(value.to_python(), {"x": 0})
+
+    def test_numbers(self):
+        for text in ('0', '-0', '1', '-1', '0.5', '-0.5', '12.25', '1e3',
+                     '1E3', '1e+3', '1e-3', '-2.5E-2', '9007199254740992',
+                     '1.7976931348623157e308', '5e-324', '123456789'):
+            self.assertEqual(ason.from_json(text).to_python(),
+                             json.loads(text))
+
+    def test_embedded_nul(self):
+        self.assertRaises(ValueError, ason.from_json, '"a\0b"')
+        self.assertRaises(ValueError, ason.from_json, b'"a\0b"')
+        self.assertRaises(ValueError, ason.from_json, '[1]\0')
+
+    def test_malformed(self):
+        for text in ('', ' ', '[', ']', '{', '[1,]', '[1 2]', '{"a"}',
+                     '{"a":}', '{"a" 1}', '{a: 1}', '{"a": 1,}', '{1: 2}',
+                     'nul', 'True', 'null null', '"abc', '"\\x"', '"\\u12"',
+                     '"\\u12g4"', '"a\nb"', '01', '-', '+1', '.5', '1.',
+                     '1e', '1e+', '0x10', "'a'", 'NaN', 'Infinity', '[1]]'):
+            self.assertRaises(ValueError, ason.from_json, text)
+
+if __name__ == "__main__":
+    unittest.main()
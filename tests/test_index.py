@@ -0,0 +1,132 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+"""Looking up members of lists and objects."""
+
+import unittest
+
+import ason
+
+LIST = '[10, "x", [1, 2], {"a": 1}, null]'
+OBJECT = '{"b": 2, "a": 1, "ab": [3], "": 0, "q\\"uote": 4, "long key": 5}'
+
+def forms(text):
+    # Parsed values are indexed by iterating them, lazy ones from their text
+    return (ason.parse(text), ason.parse_lazy(text))
+
+class ListLookup(unittest.TestCase):
+    def test_items(self):
+        for value in forms(LIST):
+            self.assertEqual(len(value), 5)
+            self.assertEqual(value[0], 10)
+            self.assertEqual(value[1], "x")
+            self.assertEqual(value[2], ason.parse('[1, 2]'))
+            self.assertEqual(value[2][1], 2)
+            self.assertEqual(value[3]["a"], 1)
+            self.assertEqual(value[4], None)
+
+    def test_negative(self):
+        for value in forms(LIST):
+            self.assertEqual(value[-1], None)
+            self.assertEqual(value[-5], 10)
+            self.assertRaises(IndexError, lambda: value[-6])
+
+    def test_out_of_range(self):
+        for value in forms(LIST):
+            self.assertRaises(IndexError, lambda: value[5])
+
+        for value in forms('[]'):
+            self.assertEqual(len(value), 0)
+            self.assertRaises(IndexError, lambda: value[0])
+            self.assertRaises(IndexError, lambda: value[-1])
+
+    def test_any_order(self):
+        for value in forms(LIST):
+            self.assertEqual([value[i] for i in (4, 0, 3, 1, 2, 0)],
+                             [None, 10, ason.parse('{"a": 1}'), "x",
+                              ason.parse('[1, 2]'), 10])
+
+    def test_contains(self):
+        for value in forms(LIST):
+            self.assertTrue(10 in value)
+            self.assertTrue("x" in value)
+            self.assertTrue(ason.parse('[1, 2]') in value)
+            self.assertFalse(11 in value)
+            self.assertFalse("a" in value)
+
+    def test_wrong_key(self):
+        for value in forms(LIST):
+            self.assertRaises(TypeError, lambda: value["a"])
+            self.assertRaises(TypeError, lambda: value[1.0])
+
+class ObjectLookup(unittest.TestCase):
+    def test_keys(self):
+        for value in forms(OBJECT):
+            self.assertEqual(len(value), 6)
+            self.assertEqual(value["a"], 1)
+            self.assertEqual(value["b"], 2)
+            self.assertEqual(value["ab"], ason.parse('[3]'))
+            self.assertEqual(value[""], 0)
+            self.assertEqual(value["q\"uote"], 4)
+            self.assertEqual(value["long key"], 5)
+
+    def test_missing(self):
+        for value in forms(OBJECT):
+            self.assertRaises(KeyError, lambda: value["c"])
+            self.assertRaises(KeyError, lambda: value["a "])
+            self.assertRaises(KeyError, lambda: value["abc"])
+
+    def test_many_keys(self):
+        text = '{%s}' % ", ".join('"k%d": %d' % (i, i) for i in range(200))
+
+        for value in forms(text):
+            self.assertEqual(len(value), 200)
+
+            for i in range(0, 200, 7):
+                self.assertEqual(value["k%d" % i], i)
+
+            self.assertRaises(KeyError, lambda: value["k200"])
+
+    def test_contains(self):
+        for value in forms(OBJECT):
+            self.assertTrue("a" in value)
+            self.assertTrue("" in value)
+            self.assertFalse("c" in value)
+            self.assertFalse(1 in value)
+
+    def test_universal(self):
+        for value in forms('{"a": 1, *}'):
+            self.assertEqual(len(value), 1)
+            self.assertEqual(value["a"], 1)
+            self.assertTrue("a" in value)
+            self.assertRaises(KeyError, lambda: value["*"])
+
+    def test_wrong_key(self):
+        for value in forms(OBJECT):
+            self.assertRaises(TypeError, lambda: value[0])
+
+class OtherValues(unittest.TestCase):
+    def test_not_indexable(self):
+        for value in (ason.ason(1), ason.ason("abc"), ason.parse('1 | 2'),
+                      ason.U):
+            self.assertRaises(TypeError, len, value)
+            self.assertRaises(TypeError, lambda: value[0])
+            self.assertRaises(TypeError, lambda: value["a"])
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,96 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+"""Lazily parsed values from parse_lazy."""
+
+import unittest
+
+import ason
+
+class ParseLazy(unittest.TestCase):
+    def check(self, text):
+        self.assertEqual(ason.parse_lazy(text), ason.parse(text))
+        self.assertEqual(ason.parse_lazy(text.encode("utf-8")),
+                         ason.parse(text))
+
+    def test_literals(self):
+        for text in ('null', 'true', 'false', '0', '-2.5e3', '"x"',
+                     '[1, 2]', '{"a": 1}', '{"a": 1, *}', '[]', '{}',
+                     ' [ 1 ] '):
+            self.check(text)
+
+    def test_expressions(self):
+        # Anything but a single literal is parsed up front
+        for text in ('1 | 2', '!"x"', '{"a": 1} & {*}', '[1, 2] | []',
+                     '"a" | ["b"]'):
+            self.check(text)
+
+        self.assertRaises(TypeError, ason.parse_lazy, '1 |')
+
+    def test_list_values(self):
+        value = ason.parse_lazy('[1, "two", [3, 4], {"five": 5}, null]')
+        self.assertEqual(list(value), [ason.ason(1), ason.ason("two"),
+                                       ason.parse('[3, 4]'),
+                                       ason.parse('{"five": 5}'),
+                                       ason.ason(None)])
+        self.assertEqual(list(value.values(plain=True))[:2], [1, "two"])
+
+    def test_object_fields(self):
+        value = ason.parse_lazy('{"a": 1, "b": [2, 3], "c": "x"}')
+        self.assertEqual(sorted(value.keys()), ["a", "b", "c"])
+        self.assertEqual(sorted(value.items(plain=True))[0], ("a", 1))
+        self.assertEqual(dict(value.items())["b"], ason.parse('[2, 3]'))
+
+    def test_universal_object(self):
+        value = ason.parse_lazy('{"a": 1, *}')
+        self.assertEqual(list(value.keys()), ["a"])
+        self.assertEqual(value, ason.parse('{"a": 1, *}'))
+
+    def test_strings_hide_punctuation(self):
+        # Commas, colons, brackets and escaped quotes in strings don't
+        # split members
+        text = r'{"a,b": "x, y", "c:d": "]}", "e\"": "[{(", "f": "\\"}'
+        value = ason.parse_lazy(text)
+        self.assertEqual(sorted(value.keys()),
+                         ["a,b", "c:d", "e\"", "f"])
+        self.assertEqual(dict(value.items(plain=True)),
+                         {"a,b": "x, y", "c:d": "]}", "e\"": "[{(",
+                          "f": "\\"})
+
+        value = ason.parse_lazy('["a, b", [1, [2, 3]], {"x": [4, 5]}]')
+        self.assertEqual(len(list(value)), 3)
+        self.check('["a, b", [1, [2, 3]], {"x": [4, 5]}]')
+
+    def test_nested_expressions(self):
+        value = ason.parse_lazy('[1 | 2, (3), {"a": !4}]')
+        self.assertEqual(list(value), [ason.parse('1 | 2'), ason.ason(3),
+                                       ason.parse('{"a": !4}')])
+
+    def test_errors_on_use(self):
+        value = ason.parse_lazy('[1, @]')
+        items = list(value)
+        self.assertEqual(items[0], ason.ason(1))
+        self.assertRaises(TypeError, repr, items[1])
+        self.assertRaises(TypeError, ason.parse_lazy('{"a": 1, @}').to_python)
+
+    def test_unbalanced(self):
+        for text in ('[1, 2', '{"a": 1', '"abc', '[1]]', '{"a": [}'):
+            self.assertRaises(TypeError, ason.parse_lazy, text)
+
+if __name__ == "__main__":
+    unittest.main()
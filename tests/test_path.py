@@ -0,0 +1,107 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+"""Path expressions from ason.path."""
+
+import unittest
+
+import ason
+
+DOC = ason.parse('''{
+    "a": {"b": [10, 20, 30], "c": "x"},
+    "items": [{"id": 1, "n": "p"}, {"id": 2}, {"id": 3, "n": "q"}],
+    "a.b": "dotted",
+    "sp ace": 4,
+    "q\\"uote": 5
+}''')
+
+def plain(values):
+    return sorted(v.to_python() for v in values)
+
+class Path(unittest.TestCase):
+    def test_keys(self):
+        self.assertEqual(ason.path('a.c')(DOC), ason.ason("x"))
+        self.assertEqual(ason.path('a.b')(DOC), ason.parse('[10, 20, 30]'))
+        self.assertEqual(ason.path('.a.c')(DOC), ason.ason("x"))
+
+    def test_indices(self):
+        self.assertEqual(ason.path('a.b[0]')(DOC), ason.ason(10))
+        self.assertEqual(ason.path('a.b[2]')(DOC), ason.ason(30))
+        self.assertEqual(ason.path('a.b[-1]')(DOC), ason.ason(30))
+        self.assertEqual(ason.path('a.b[-3]')(DOC), ason.ason(10))
+        self.assertEqual(ason.path('items[1].id')(DOC), ason.ason(2))
+
+    def test_out_of_range(self):
+        self.assertEqual(ason.path('a.b[3]')(DOC), None)
+        self.assertEqual(ason.path('a.b[-4]')(DOC), None)
+        self.assertEqual(ason.path('a.b[3]')(DOC, "none"), "none")
+        self.assertEqual(ason.path('a.b[3]')(DOC, default=0), 0)
+
+    def test_missing(self):
+        self.assertEqual(ason.path('nope')(DOC), None)
+        self.assertEqual(ason.path('a.c.d')(DOC), None)
+        self.assertEqual(ason.path('a[0]')(DOC), None)
+        self.assertEqual(ason.path('a.b.c')(DOC), None)
+
+    def test_quoted_keys(self):
+        self.assertEqual(ason.path('["a.b"]')(DOC), ason.ason("dotted"))
+        self.assertEqual(ason.path('."a.b"')(DOC), ason.ason("dotted"))
+        self.assertEqual(ason.path('"sp ace"')(DOC), ason.ason(4))
+        self.assertEqual(ason.path('["q\\"uote"]')(DOC), ason.ason(5))
+        self.assertEqual(ason.path('["a"].c')(DOC), ason.ason("x"))
+
+    def test_wildcards(self):
+        self.assertEqual(plain(ason.path('items[*].id')(DOC)), [1, 2, 3])
+        self.assertEqual(plain(ason.path('items.*.id')(DOC)), [1, 2, 3])
+        self.assertEqual(plain(ason.path('items[*].n')(DOC)), ["p", "q"])
+
+        found = ason.path('a.*')(DOC)
+        self.assertEqual(len(found), 2)
+        self.assertTrue(ason.ason("x") in found)
+        self.assertTrue(ason.parse('[10, 20, 30]') in found)
+        self.assertEqual(ason.path('nope[*]')(DOC), [])
+
+    def test_several(self):
+        p = ason.path('a.c', 'items[*].id', 'nope', 'a.c')
+        c, ids, nope, again = p(DOC, default=-1)
+        self.assertEqual(c, ason.ason("x"))
+        self.assertEqual(plain(ids), [1, 2, 3])
+        self.assertEqual(nope, -1)
+        self.assertEqual(again, ason.ason("x"))
+        self.assertEqual(p.expressions,
+                         ('a.c', 'items[*].id', 'nope', 'a.c'))
+
+    def test_same_wildcard_twice(self):
+        first, second = ason.path('items[*].id', 'items[*].id')(DOC)
+        self.assertEqual(plain(first), [1, 2, 3])
+        self.assertEqual(plain(second), [1, 2, 3])
+        self.assertFalse(first is second)
+
+    def test_python_values(self):
+        self.assertEqual(ason.path('a[1]')({"a": [1, 2]}), ason.ason(2))
+
+    def test_bad_expressions(self):
+        for expr in ('[', '[1', '[x]', '[]', 'a..b', 'a.', '.', '["a',
+                     '["a"', 'a"b"', '[1]x', 'a[', 'a]'):
+            self.assertRaises(ValueError, ason.path, expr)
+
+        self.assertRaises(TypeError, ason.path)
+        self.assertRaises(TypeError, ason.path, 1)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,127 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+"""Streaming values with AsonReader."""
+
+import io
+import os
+import unittest
+
+import ason
+
+TEXT = ('1\n'
+        '\n'
+        '"two, [three]"\n'
+        '[4,\n 5]\n'
+        '{"a": "b\\"}[",\n "c": {"d":\n [6]}}\n'
+        '  null  \n'
+        '7 | 8')
+
+VALUES = [ason.ason(1), ason.ason("two, [three]"), ason.parse('[4, 5]'),
+          ason.parse('{"a": "b\\"}[", "c": {"d": [6]}}'), ason.ason(None),
+          ason.parse('7 | 8')]
+
+class Reader(unittest.TestCase):
+    def test_feed(self):
+        reader = ason.AsonReader()
+        reader.feed(TEXT.encode("utf-8"))
+        self.assertEqual(list(reader), VALUES[:-1])
+        reader.close()
+        self.assertEqual(list(reader), VALUES[-1:])
+
+    def test_feed_bytewise(self):
+        reader = ason.AsonReader()
+        got = []
+        data = TEXT.encode("utf-8")
+
+        for i in range(len(data)):
+            reader.feed(data[i:i + 1])
+            got.extend(reader)
+
+        reader.close()
+        got.extend(reader)
+        self.assertEqual(got, VALUES)
+
+    def test_feed_then_more(self):
+        reader = ason.AsonReader()
+        reader.feed(b'[1, ')
+        self.assertEqual(list(reader), [])
+        reader.feed(b'2]\n{"a"')
+        self.assertEqual(list(reader), [ason.parse('[1, 2]')])
+        reader.feed(b': 3}')
+        self.assertEqual(list(reader), [])
+        reader.close()
+        self.assertEqual(list(reader), [ason.parse('{"a": 3}')])
+        self.assertEqual(list(reader), [])
+
+    def test_trailing_newline(self):
+        reader = ason.AsonReader()
+        reader.feed(b'1\n2\n')
+        self.assertEqual(list(reader), [ason.ason(1), ason.ason(2)])
+        reader.close()
+        self.assertEqual(list(reader), [])
+
+    def test_file_source(self):
+        for chunk_size in (1, 2, 3, 7, 64, 65536):
+            source = io.BytesIO(TEXT.encode("utf-8"))
+            reader = ason.AsonReader(source, chunk_size)
+            self.assertEqual(list(reader), VALUES)
+
+    def test_text_source(self):
+        reader = ason.AsonReader(io.StringIO(u'"caf\xe9"\n[1]'), 3)
+        self.assertEqual(list(reader), [ason.ason(u"caf\xe9"),
+                                        ason.parse('[1]')])
+
+    def test_fd_source(self):
+        read_fd, write_fd = os.pipe()
+
+        try:
+            os.write(write_fd, TEXT.encode("utf-8"))
+            os.close(write_fd)
+            reader = ason.AsonReader(read_fd, chunk_size=5)
+            self.assertEqual(list(reader), VALUES)
+        finally:
+            os.close(read_fd)
+
+    def test_one_line_records(self):
+        # Outside brackets a newline always ends a record
+        reader = ason.AsonReader(io.BytesIO(b'1 |\n2\n'))
+        self.assertRaises(TypeError, next, reader)
+        self.assertEqual(next(reader), ason.ason(2))
+
+    def test_bad_record(self):
+        reader = ason.AsonReader(io.BytesIO(b'1\n[1,,]\n3\n'))
+        self.assertEqual(next(reader), ason.ason(1))
+        self.assertRaises(TypeError, next, reader)
+        self.assertEqual(next(reader), ason.ason(3))
+
+    def test_nul(self):
+        reader = ason.AsonReader()
+        self.assertRaises(ValueError, reader.feed, b'1\0\n')
+
+        # The NUL is only seen once the chunk holding it is read
+        reader = ason.AsonReader(io.BytesIO(b'1\n"a\0b"\n'), 2)
+        self.assertEqual(next(reader), ason.ason(1))
+        self.assertRaises(ValueError, next, reader)
+
+    def test_bad_arguments(self):
+        self.assertRaises(TypeError, ason.AsonReader, object())
+        self.assertRaises(ValueError, ason.AsonReader, None, 0)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,64 @@
+# -*- coding: utf-8 -*-
+# Copyright © 2014 Casey Dahlin <casey.dahlin@gmail.com>
+#
+# This file is part of pyason.
+#
+# pyason is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# pyason is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pyason. If not, see <http://www.gnu.org/licenses/>.
+
+"""Templates from ason.compile."""
+
+import unittest
+
+import ason
+
+class Templates(unittest.TestCase):
+    def test_variables(self):
+        t = ason.compile('{"id": id, "tags": [tag, "common", tag]}')
+        self.assertEqual(t.variables, ("id", "tag"))
+
+    def test_keywords_are_not_variables(self):
+        t = ason.compile('[null, true, false, U, x]')
+        self.assertEqual(t.variables, ("x",))
+
+    def test_strings_and_numbers_are_not_variables(self):
+        t = ason.compile('["name", 1e5, 2.5E-3, n]')
+        self.assertEqual(t.variables, ("n",))
+
+    def test_matches_parse(self):
+        text = '{"id": id, "tags": [tag, "common"], *}'
+        t = ason.compile(text)
+
+        for i in range(3):
+            self.assertEqual(t(id=i, tag="t%d" % i),
+                             ason.parse(text, id=i, tag="t%d" % i))
+
+    def test_rebinding(self):
+        t = ason.compile('[x, x]')
+        self.assertEqual(t(x=1), ason.parse('[1, 1]'))
+        self.assertEqual(t(x="a"), ason.parse('["a", "a"]'))
+        self.assertEqual(t(x=ason.parse('1 | 2')), ason.parse('[1 | 2, 1 | 2]'))
+
+    def test_unknown_word_must_be_bound(self):
+        t = ason.compile('[nul]')
+        self.assertEqual(t.variables, ("nul",))
+        self.assertRaises(TypeError, t)
+
+    def test_wrong_bindings(self):
+        t = ason.compile('[x, y]')
+        self.assertRaises(TypeError, t, x=1)
+        self.assertRaises(TypeError, t, x=1, z=2)
+        self.assertRaises(TypeError, t, 1, 2)
+
+if __name__ == "__main__":
+    unittest.main()